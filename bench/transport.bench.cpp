@@ -0,0 +1,52 @@
+#include "test/framework.h"
+
+#include <nsl/shm/stream.hpp>
+#include <nsl/udp/stream.hpp>
+
+#include <boost/asio.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+#include <fmt/format.h>
+
+#include <cstddef>
+#include <vector>
+
+using namespace nsl;
+
+// Each iteration sends one datagram and then reads it back on the same thread, so these measure the cost of getting a
+// datagram from one stream to the other, without any thread hand-offs.
+TEST_CASE("same-host transports", "[benchmark]") {
+  auto io = boost::asio::io_context{};
+
+  const auto datagram_size = GENERATE(size_t{64}, size_t{1024}, size_t{4096});
+
+  auto sent     = std::vector<std::byte>(datagram_size, std::byte{0x5A});
+  auto received = std::vector<std::byte>(datagram_size);
+
+  SECTION(fmt::format("{} byte datagrams", datagram_size)) {
+    {
+      constexpr auto bench_port = udp::port_number{41000};
+
+      auto udp_in  = udp::istream{io, bench_port};
+      auto udp_out = udp::ostream{io, "localhost", bench_port};
+
+      BENCHMARK(fmt::format("UDP loopback, {} bytes", datagram_size)) {
+        udp_out << sent << udp::flush;
+        udp_in >> received;
+        return received.front();
+      };
+    }
+
+    {
+      auto shm_in  = shm::istream{io, "nsl_transport_bench"};
+      auto shm_out = shm::ostream{io, "nsl_transport_bench"};
+
+      BENCHMARK(fmt::format("shared memory ring, {} bytes", datagram_size)) {
+        shm_out << sent << shm::flush;
+        shm_in >> received;
+        return received.front();
+      };
+    }
+  }
+}
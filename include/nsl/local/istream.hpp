@@ -0,0 +1,62 @@
+#pragma once
+
+#include <nsl/udp/coalesce.hpp>
+#include <nsl/udp/istream.hpp>
+#include <nsl/udp/sequenced.hpp>
+
+#include <boost/asio/local/datagram_protocol.hpp>
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace nsl::local {
+
+using udp::async_recv_fn_like;
+using udp::contiguous_byte_range_like;
+using udp::deframed;
+using udp::dispatch_to;
+using udp::dispatched_recv_fn;
+using udp::ignore_gaps;
+using udp::latency_histogram;
+using udp::receive_ring;
+using udp::receive_ring_options;
+using udp::receive_tap;
+using udp::recv_result;
+using udp::recv_status;
+using udp::ring_recv_fn;
+using udp::sequenced;
+using udp::sequenced_options;
+using udp::sequenced_stats;
+using udp::worker_pool;
+
+// A name in Linux's abstract socket namespace, which doesn't exist on the filesystem and goes away with the last socket
+// that's bound to it.
+[[nodiscard]] inline std::string abstract_path(std::string_view name) {
+  return std::string(1, '\0').append(name);
+}
+
+namespace detail {
+  using source = udp::detail::basic_source<boost::asio::local::datagram_protocol>;
+}  // namespace detail
+
+using istreambuf = boost::iostreams::stream_buffer<detail::source>;
+
+// Receives datagrams on a Unix domain socket bound to path. If there's already a socket file at path (left behind by an
+// earlier process, say) it's replaced, and the file is removed again when the stream is destroyed. Otherwise, it reads
+// just like a udp::istream.
+class istream : public boost::iostreams::stream<detail::source>, public udp::datagram_istream<istream> {
+ public:
+  explicit istream(boost::asio::io_context& io, std::string path)
+      : boost::iostreams::stream<detail::source>{
+            detail::source{io, boost::asio::local::datagram_protocol::endpoint{std::move(path)}}} {}
+
+  explicit istream(boost::asio::io_context& io, std::shared_ptr<boost::asio::local::datagram_protocol::socket> socket)
+      : boost::iostreams::stream<detail::source>{detail::source{io, std::move(socket)}} {}
+};
+
+}  // namespace nsl::local
+
+#endif
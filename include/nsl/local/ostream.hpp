@@ -0,0 +1,50 @@
+#pragma once
+
+#include <nsl/udp/ostream.hpp>
+
+#include <boost/asio/local/datagram_protocol.hpp>
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+
+#include <memory>
+#include <string>
+
+namespace nsl::local {
+
+using udp::async_send_fn_like;
+using udp::byte_range_sequence_like;
+using udp::coalesce_options;
+using udp::contiguous_byte_range_like;
+using udp::flush;
+using udp::gather;
+using udp::gathered_datagram;
+using udp::overflow_policy;
+using udp::probe_options;
+using udp::send_queue_options;
+
+namespace detail {
+  using sink = udp::detail::basic_sink<boost::asio::local::datagram_protocol>;
+}  // namespace detail
+
+using ostreambuf = boost::iostreams::stream_buffer<detail::sink>;
+
+// Sends datagrams to the Unix domain socket bound to path. The sending socket itself isn't bound to anything, so the
+// receiver can't reply to it. Everything else (probing, sequencing, coalescing, prepare/commit and gathered sends) is the
+// same as for a udp::ostream.
+class ostream : public boost::iostreams::stream<detail::sink>, public udp::datagram_ostream<ostream> {
+ public:
+  explicit ostream(boost::asio::io_context& io, std::string path, send_queue_options send_opts = send_queue_options{})
+      : boost::iostreams::stream<detail::sink>{
+            detail::sink{io, boost::asio::local::datagram_protocol::endpoint{std::move(path)}, send_opts}} {}
+
+  explicit ostream(boost::asio::io_context& io,
+                   std::shared_ptr<boost::asio::local::datagram_protocol::socket> socket,
+                   std::string path,
+                   send_queue_options send_opts = send_queue_options{})
+      : boost::iostreams::stream<detail::sink>{
+            detail::sink{io, std::move(socket), boost::asio::local::datagram_protocol::endpoint{std::move(path)}, send_opts}} {}
+};
+
+}  // namespace nsl::local
+
+#endif
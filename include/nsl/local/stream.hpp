@@ -0,0 +1,38 @@
+#pragma once
+
+#include <nsl/local/istream.hpp>
+#include <nsl/local/ostream.hpp>
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+
+namespace nsl::local {
+
+// Like udp::stream, both directions use the one socket, so the peer can reply to the address that datagrams come from.
+class stream : public istream, public ostream {
+ public:
+  explicit stream(boost::asio::io_context& io,
+                  std::string local_path,
+                  std::string remote_path,
+                  send_queue_options send_opts = send_queue_options{})
+      : stream{io,
+               udp::detail::bind_socket(io, boost::asio::local::datagram_protocol::endpoint{std::move(local_path)}),
+               std::move(remote_path),
+               send_opts} {}
+
+  // Probes both directions: datagrams sent are stamped, and the latency of the ones received from a probing peer is recorded.
+  std::shared_ptr<latency_histogram> enable_latency_probe(probe_options opts = probe_options{}) {
+    ostream::enable_latency_probe(opts);
+    return istream::enable_latency_probe();
+  }
+
+ private:
+  explicit stream(boost::asio::io_context& io,
+                  std::shared_ptr<boost::asio::local::datagram_protocol::socket> socket,
+                  std::string remote_path,
+                  send_queue_options send_opts)
+      : istream{io, socket}, ostream{io, socket, std::move(remote_path), send_opts} {}
+};
+
+}  // namespace nsl::local
+
+#endif
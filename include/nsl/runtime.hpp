@@ -0,0 +1,136 @@
+#pragma once
+
+#include <nsl/udp/stream.hpp>
+
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace nsl {
+
+using cpu_id = std::size_t;
+
+///
+/// Owns a set of workers, each of which is an io_context that's run by its own thread. Streams that are created through the
+/// runtime are spread across the contexts in a round-robin fashion, so that socket servicing can scale across cores.
+///
+/// Threads can optionally be pinned to CPUs: thread i is pinned to cpu_affinity[i % cpu_affinity.size()]. Pinning is
+/// supported on Windows and Linux; on other platforms the affinity is ignored. If a thread can't be pinned (because the CPU
+/// id is out of range, say), the constructor throws std::system_error.
+///
+/// Any streams created via the runtime (or on one of its contexts) must be destroyed before the runtime is.
+///
+class runtime {
+  struct worker {
+    boost::asio::io_context io{1};
+    std::optional<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> work{io.get_executor()};
+    std::thread thread{};
+  };
+
+ public:
+  explicit runtime(std::size_t thread_count = 1, std::vector<cpu_id> cpu_affinity = {}) {
+    _workers.reserve(std::max(thread_count, std::size_t{1}));
+
+    try {
+      for (auto i = std::size_t{0}; i < std::max(thread_count, std::size_t{1}); ++i) {
+        auto& wkr  = *_workers.emplace_back(std::make_unique<worker>());
+        wkr.thread = std::thread{[&io = wkr.io]() { io.run(); }};
+
+        if (not cpu_affinity.empty()) {
+          _pin_thread(wkr.thread, cpu_affinity[i % cpu_affinity.size()]);
+        }
+      }
+    } catch (...) {
+      stop();
+      throw;
+    }
+  }
+
+  runtime(const runtime&)            = delete;
+  runtime& operator=(const runtime&) = delete;
+  runtime(runtime&&)                 = delete;
+  runtime& operator=(runtime&&)      = delete;
+
+  ~runtime() { stop(); }
+
+  [[nodiscard]] std::size_t size() const noexcept { return _workers.size(); }
+
+  [[nodiscard]] boost::asio::io_context& context(std::size_t idx) { return _workers.at(idx)->io; }
+
+  [[nodiscard]] boost::asio::io_context& next_context() noexcept {
+    return _workers[_next_context.fetch_add(1, std::memory_order_relaxed) % _workers.size()]->io;
+  }
+
+  [[nodiscard]] udp::istream make_istream(udp::port_number port) { return udp::istream{next_context(), port}; }
+
+  [[nodiscard]] udp::ostream make_ostream(std::string host,
+                                          udp::port_number port,
+                                          udp::send_queue_options send_opts = udp::send_queue_options{}) {
+    return udp::ostream{next_context(), std::move(host), port, send_opts};
+  }
+
+  [[nodiscard]] udp::stream make_stream(udp::port_number local_port,
+                                        std::string remote_host,
+                                        udp::port_number remote_port,
+                                        udp::send_queue_options send_opts = udp::send_queue_options{}) {
+    return udp::stream{next_context(), local_port, std::move(remote_host), remote_port, send_opts};
+  }
+
+  // Any work still queued on the contexts is abandoned. Safe to call more than once.
+  void stop() {
+    for (auto& ctx : _workers) {
+      ctx->work.reset();
+      ctx->io.stop();
+    }
+
+    for (auto& ctx : _workers) {
+      if (ctx->thread.joinable()) {
+        ctx->thread.join();
+      }
+    }
+  }
+
+ private:
+  static void _pin_thread([[maybe_unused]] std::thread& thread, [[maybe_unused]] cpu_id cpu) {
+#if defined(_WIN32)
+    if (cpu >= sizeof(DWORD_PTR) * 8 or
+        0 == ::SetThreadAffinityMask(thread.native_handle(), DWORD_PTR{1} << cpu)) {
+      throw std::system_error{static_cast<int>(::GetLastError()), std::system_category(), "failed to set thread affinity"};
+    }
+#elif defined(__linux__)
+    if (cpu >= CPU_SETSIZE) {
+      throw std::system_error{EINVAL, std::generic_category(), "failed to set thread affinity"};
+    }
+
+    auto cpus = cpu_set_t{};
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+
+    if (const auto err = ::pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus); err != 0) {
+      throw std::system_error{err, std::generic_category(), "failed to set thread affinity"};
+    }
+#endif
+  }
+
+  std::vector<std::unique_ptr<worker>> _workers;
+  std::atomic_size_t _next_context{0};
+};
+
+}  // namespace nsl
@@ -0,0 +1,245 @@
+#pragma once
+
+#include "ring.hpp"
+
+#include <nsl/udp/types.hpp>
+
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/stream.hpp>
+
+#include <wite/core/scope.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+namespace nsl::shm {
+
+using udp::async_recv_fn_like;
+using udp::contiguous_byte_range_like;
+
+namespace detail {
+
+  class source {
+    struct kernel {
+      kernel(boost::asio::io_context& io, std::string channel, std::size_t capacity)
+          : io{io}, ring{std::move(channel), capacity, true}, drain_strand{boost::asio::make_strand(io)} {}
+
+      ~kernel() { stop_waiting(); }
+
+      // Waits for a drain that's running to finish, unless it's the drain's own callback that's stopping the read. That drain
+      // stops as soon as the callback returns, and the strand keeps any drains for the next read behind it.
+      void stop_waiting() {
+        cancelled = true;
+        ring.interrupt();
+        {
+          auto lock = std::unique_lock{mtx};
+          drained.wait(lock, [this]() { return not draining or drain_thread == std::this_thread::get_id(); });
+          drain_pending = 0;
+        }
+        drained.notify_all();
+
+        if (waiter.joinable()) {
+          waiter.join();
+        }
+
+        work.reset();
+      }
+
+      boost::asio::io_context& io;
+      detail::ring ring;
+      std::atomic_bool async_read_in_progress{false};
+      std::atomic_bool sync_read_in_progress{false};
+      std::atomic_bool cancelled{false};
+      std::atomic_uint64_t generation{0};
+      std::size_t read_offset{0};
+
+      // Nothing is waiting on the io_context's own sockets, so this stops it from running out of work while we're receiving.
+      std::optional<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> work{};
+      std::thread waiter{};
+
+      // The datagrams are drained on the strand, so that a drain for a read that's been cancelled can never run alongside
+      // one for the read that replaced it.
+      boost::asio::strand<boost::asio::io_context::executor_type> drain_strand;
+      std::mutex mtx;
+      std::condition_variable drained;
+      std::uint64_t drain_pending{0};  // Guarded by mtx: the generation whose drain has been posted and hasn't finished...
+      bool draining{false};            // ...whether a drain is running, and...
+      std::thread::id drain_thread{};  // ...the thread it's running on.
+    };
+
+   public:
+    using char_type = char;
+    using category  = boost::iostreams::source_tag;
+
+    explicit source(boost::asio::io_context& io, std::string channel, std::size_t capacity = default_capacity)
+        : _in_kernel{std::make_shared<kernel>(io, std::move(channel), capacity)} {}
+
+    source()                         = delete;
+    source(const source&)            = default;
+    source& operator=(const source&) = delete;
+    source(source&&)                 = default;
+    source& operator=(source&&)      = default;
+
+    ~source() {}
+
+    // Like a UDP socket, each call returns (at most) one datagram. If n is smaller than the datagram, the rest of it is
+    // returned by the following reads.
+    [[nodiscard]] std::streamsize read(char* s, std::streamsize n) {
+      if (_in_kernel->async_read_in_progress) {
+        return -1;
+      }
+
+      _in_kernel->sync_read_in_progress = true;
+      auto _                            = wite::scope_exit{[this]() { _in_kernel->sync_read_in_progress = false; }};
+
+      auto& ring = _in_kernel->ring;
+      while (not _in_kernel->cancelled.load()) {
+        if (auto datagram = ring.peek()) {
+          const auto offset = _in_kernel->read_offset;
+          const auto count  = std::min(datagram->size() - offset, static_cast<std::size_t>(n));
+          std::memcpy(s, datagram->data() + offset, count);
+
+          if (offset + count == datagram->size()) {
+            ring.pop(*datagram);
+            _in_kernel->read_offset = 0;
+          } else {
+            _in_kernel->read_offset += count;
+          }
+
+          return static_cast<std::streamsize>(count);
+        }
+
+        ring.wait_for_data(_in_kernel->cancelled);
+      }
+
+      return -1;
+    }
+
+    // Datagrams are handed to the callback in place, on the io_context's thread. A helper thread waits for the ring to
+    // become non-empty and posts the work to the io_context.
+    template <async_recv_fn_like Callback_T>
+    bool async_read(Callback_T&& callback) {
+      if (_in_kernel->sync_read_in_progress.load() or _in_kernel->async_read_in_progress.exchange(true)) {
+        return false;
+      }
+
+      auto cb  = std::make_shared<std::decay_t<Callback_T>>(std::forward<Callback_T>(callback));
+      auto gen = ++_in_kernel->generation;
+
+      _in_kernel->work.emplace(_in_kernel->io.get_executor());
+
+      _in_kernel->waiter = std::thread{[k = _in_kernel.get(), cb = std::move(cb), gen, weak = std::weak_ptr{_in_kernel}]() {
+        while (k->ring.wait_for_data(k->cancelled)) {
+          {
+            auto _           = std::unique_lock{k->mtx};
+            k->drain_pending = gen;
+          }
+
+          boost::asio::post(k->drain_strand, [cb, gen, weak]() {
+            if (auto kernel = weak.lock()) {
+              _drain(*kernel, *cb, gen);
+            }
+          });
+
+          auto lock = std::unique_lock{k->mtx};
+          k->drained.wait(lock, [k, gen]() { return k->drain_pending != gen or k->cancelled.load(); });
+        }
+      }};
+
+      return true;
+    }
+
+    void cancel_async_read() {
+      if (not _in_kernel->async_read_in_progress.load()) {
+        return;
+      }
+
+      // The generation is moved on under the lock, so that a drain that's about to start either sees it, or is waited for.
+      {
+        auto _ = std::unique_lock{_in_kernel->mtx};
+        ++_in_kernel->generation;
+      }
+
+      _in_kernel->stop_waiting();
+      _in_kernel->cancelled              = false;
+      _in_kernel->async_read_in_progress = false;
+    }
+
+    void cancel_sync_read() {
+      if (not _in_kernel->sync_read_in_progress.load()) {
+        return;
+      }
+
+      _in_kernel->cancelled = true;
+      _in_kernel->ring.interrupt();
+      while (_in_kernel->sync_read_in_progress.load()) {
+        std::this_thread::yield();
+      }
+      _in_kernel->cancelled = false;
+    }
+
+   private:
+    // A drain that was posted for a read that's since been cancelled does nothing, and leaves drain_pending alone, since
+    // that now belongs to the read that replaced it.
+    template <typename Callback_T>
+    static void _drain(kernel& k, Callback_T& callback, std::uint64_t gen) {
+      {
+        auto _ = std::unique_lock{k.mtx};
+        if (gen != k.generation.load()) {
+          return;
+        }
+
+        k.draining     = true;
+        k.drain_thread = std::this_thread::get_id();
+      }
+
+      auto _ = wite::scope_exit{[&k, gen]() {
+        {
+          auto lock  = std::unique_lock{k.mtx};
+          k.draining = false;
+          if (k.drain_pending == gen) {
+            k.drain_pending = 0;
+          }
+        }
+        k.drained.notify_all();
+      }};
+
+      while (gen == k.generation.load()) {
+        auto datagram = k.ring.peek();
+        if (not datagram) {
+          break;
+        }
+
+        auto data_stream = boost::iostreams::stream<boost::iostreams::array_source>{datagram->data(), datagram->size()};
+        callback(data_stream, datagram->size());
+
+        k.ring.pop(*datagram);
+      }
+    }
+
+    std::shared_ptr<kernel> _in_kernel;
+  };
+}  // namespace detail
+
+using istreambuf = boost::iostreams::stream_buffer<detail::source>;
+class istream : public boost::iostreams::stream<detail::source>, public udp::datagram_istream<istream> {
+ public:
+  explicit istream(boost::asio::io_context& io, std::string channel, std::size_t capacity = default_capacity)
+      : boost::iostreams::stream<detail::source>{detail::source{io, std::move(channel), capacity}} {}
+};
+
+}  // namespace nsl::shm
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "ring.hpp"
+
+#include <nsl/udp/ostream.hpp>
+#include <nsl/udp/types.hpp>
+
+#include <boost/asio/error.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/iostreams/stream.hpp>
+#include <boost/system/system_error.hpp>
+
+#include <wite/core/scope.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <span>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace nsl::shm {
+
+using udp::async_send_fn_like;
+using udp::contiguous_byte_range_like;
+using udp::flush;
+
+namespace detail {
+
+  class sink {
+    struct kernel {
+      kernel(boost::asio::io_context& io, std::string channel, std::size_t capacity)
+          : io{io}, ring{std::move(channel), capacity, false} {}
+
+      boost::asio::io_context& io;
+      detail::ring ring;
+      std::atomic_bool write_in_progress{false};
+      std::atomic_bool cancelled{false};
+    };
+
+   public:
+    using char_type = char;
+    using category  = boost::iostreams::sink_tag;
+
+    explicit sink(boost::asio::io_context& io, std::string channel, std::size_t capacity = default_capacity)
+        : _out_kernel{std::make_shared<kernel>(io, std::move(channel), capacity)} {}
+
+    sink()                       = delete;
+    sink(const sink&)            = default;
+    sink& operator=(const sink&) = delete;
+    sink(sink&&)                 = default;
+    sink& operator=(sink&&)      = default;
+
+    ~sink() {}
+
+    // Each call is written to the ring as a single datagram. Blocks while the ring is full. A cancelled write throws, since
+    // boost::iostreams doesn't take a -1 from a sink as a failure; the stream catches it and sets its badbit.
+    [[nodiscard]] std::streamsize write(const char* s, std::streamsize n) {
+      _out_kernel->write_in_progress = true;
+      auto _                         = wite::scope_exit{[this]() { _out_kernel->write_in_progress = false; }};
+      if (not _out_kernel->ring.write({s, static_cast<std::size_t>(n)}, _out_kernel->cancelled)) {
+        throw boost::system::system_error{boost::asio::error::operation_aborted};
+      }
+
+      return n;
+    }
+
+    // Writing to the ring doesn't need the io_context, so the data goes straight into the ring and only the callback is
+    // posted to the io_context. This never waits: if the ring is full, the datagram is rejected (and the stream's failbit is
+    // set), like a udp::ostream's async write is when its send queue is full.
+    template <typename Data_T, async_send_fn_like Callback_T>
+    [[nodiscard]] bool async_write(std::pair<Data_T, Callback_T>&& data_and_callback) {
+      const auto& data = data_and_callback.first;
+      const auto n     = data.size() * sizeof(typename Data_T::value_type);
+
+      if (not _out_kernel->ring.try_write({reinterpret_cast<const char*>(data.data()), n})) {
+        return false;
+      }
+
+      boost::asio::post(_out_kernel->io, [cb = std::move(data_and_callback.second), n]() mutable {
+        if constexpr (std::is_invocable_v<Callback_T&, const boost::system::error_code&, size_t>) {
+          cb(boost::system::error_code{}, n);
+        } else {
+          cb(n);
+        }
+      });
+
+      return true;
+    }
+
+    // Returns room for the next datagram in the ring itself, so that it can be built in place. Blocks while the ring is full,
+    // and returns an empty span if that's cancelled. Nothing else can be written until the datagram is committed.
+    [[nodiscard]] std::span<char> prepare(std::size_t n) {
+      _out_kernel->write_in_progress = true;
+      auto _                         = wite::scope_exit{[this]() { _out_kernel->write_in_progress = false; }};
+      return _out_kernel->ring.prepare(n, _out_kernel->cancelled).value_or(std::span<char>{});
+    }
+
+    // Hands the first n bytes of the prepared room to the reader as exactly one datagram.
+    std::size_t commit(std::size_t n) {
+      _out_kernel->ring.commit(n);
+      return n;
+    }
+
+    // Unblocks a write that's waiting for the reader to make space in the ring, which then fails. Without this, a writer
+    // whose reader has stopped (or died) would wait forever.
+    void cancel_write() {
+      if (not _out_kernel->write_in_progress.load()) {
+        return;
+      }
+
+      _out_kernel->cancelled = true;
+      _out_kernel->ring.interrupt();
+      while (_out_kernel->write_in_progress.load()) {
+        std::this_thread::yield();
+      }
+      _out_kernel->cancelled = false;
+    }
+
+    [[nodiscard]] std::size_t max_datagram_size() const noexcept { return _out_kernel->ring.max_datagram_size(); }
+
+   private:
+    std::shared_ptr<kernel> _out_kernel;
+  };
+}  // namespace detail
+
+using ostreambuf = boost::iostreams::stream_buffer<detail::sink>;
+class ostream : public boost::iostreams::stream<detail::sink>, public udp::datagram_ostream<ostream> {
+ public:
+  explicit ostream(boost::asio::io_context& io, std::string channel, std::size_t capacity = default_capacity)
+      : boost::iostreams::stream<detail::sink>{detail::sink{io, std::move(channel), capacity}} {}
+
+  // Anything that's still buffered in the stream is written first, since the room that's returned is the next thing in the
+  // ring.
+  [[nodiscard]] std::span<char> prepare(std::size_t n) {
+    flush();
+    return (*this)->prepare(n);
+  }
+
+  std::size_t commit(std::size_t n) { return (*this)->commit(n); }
+
+  void cancel_send() { (*this)->cancel_write(); }
+};
+
+}  // namespace nsl::shm
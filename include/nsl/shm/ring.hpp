@@ -0,0 +1,332 @@
+#pragma once
+
+#include <boost/interprocess/exceptions.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <ctime>
+#endif
+
+namespace nsl::shm {
+
+constexpr auto default_capacity = std::size_t{1} << 20;
+
+namespace detail {
+
+  using namespace std::chrono_literals;
+
+  static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t) and std::atomic<std::uint32_t>::is_always_lock_free);
+  static_assert(std::atomic<std::uint64_t>::is_always_lock_free);
+
+  // Blocks until the word is changed from expected by another process (or the timeout expires). On platforms without
+  // futexes this just backs off for a bit, so callers always have to re-check their condition.
+  inline void wait_on(std::atomic<std::uint32_t>& word, std::uint32_t expected, std::chrono::microseconds timeout) {
+#if defined(__linux__)
+    const auto secs = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+    auto ts         = timespec{};
+    ts.tv_sec       = static_cast<decltype(ts.tv_sec)>(secs.count());
+    ts.tv_nsec      = static_cast<decltype(ts.tv_nsec)>(std::chrono::nanoseconds{timeout - secs}.count());
+
+    ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+#else
+    if (word.load() == expected) {
+      std::this_thread::sleep_for(std::min(timeout, std::chrono::microseconds{50}));
+    }
+#endif
+  }
+
+  inline void wake_all([[maybe_unused]] std::atomic<std::uint32_t>& word) {
+#if defined(__linux__)
+    ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAKE, std::numeric_limits<int>::max(), nullptr, nullptr, 0);
+#endif
+  }
+
+  // A single-producer, single-consumer ring of datagrams in a named shared memory segment. Each datagram is stored as a
+  // 4-byte length followed by the data, padded to 8 bytes. Datagrams never wrap around the end of the ring: if one won't fit
+  // in the space that's left, a wrap marker is written and it goes at the start instead.
+  class ring {
+    struct header {
+      std::atomic<std::uint32_t> state;  // 0 = new (the segment is zero-filled), 1 = being initialised, 2 = ready.
+      std::uint32_t version;
+      std::uint64_t capacity;
+
+      alignas(64) std::atomic<std::uint64_t> head;  // Total bytes written. Only the writer changes this.
+      alignas(64) std::atomic<std::uint64_t> tail;  // Total bytes consumed. Only the reader changes this.
+
+      alignas(64) std::atomic<std::uint32_t> data_seq;  // Bumped when something is written; the reader sleeps on it.
+      std::atomic<std::uint32_t> reader_waiting;
+
+      alignas(64) std::atomic<std::uint32_t> space_seq;  // Bumped when something is consumed; the writer sleeps on it.
+      std::atomic<std::uint32_t> writer_waiting;
+    };
+
+    static constexpr auto version     = std::uint32_t{1};
+    static constexpr auto length_size = sizeof(std::uint32_t);
+    static constexpr auto wrap_marker = std::numeric_limits<std::uint32_t>::max();
+    static constexpr auto data_offset = (sizeof(header) + 63) & ~std::size_t{63};
+    static constexpr auto wait_slice  = std::chrono::microseconds{100ms};
+    static constexpr auto init_wait   = std::chrono::seconds{1};  // How long an opener waits for the creator to set up.
+
+    [[nodiscard]] static constexpr std::size_t _record_size(std::size_t n) noexcept {
+      return (length_size + n + 7) & ~std::size_t{7};
+    }
+
+   public:
+    // Opens the named ring, creating it with the given capacity if it doesn't exist yet. If remove_on_close is set, the name
+    // is removed when this object is destroyed (anyone who already has the ring open can carry on using it). Only the process
+    // that creates the segment sizes and initialises it; anyone else waits for that, and throws if it isn't done within
+    // init_wait (because the creator died part way through, say).
+    ring(std::string name, std::size_t capacity, bool remove_on_close)
+        : _name{std::move(name)}, _remove_on_close{remove_on_close} {
+      namespace bip = boost::interprocess;
+
+      capacity = (std::max(capacity, std::size_t{64}) + 7) & ~std::size_t{7};
+
+      const auto give_up_at = std::chrono::steady_clock::now() + init_wait;
+
+      auto shm     = bip::shared_memory_object{};
+      auto created = false;
+      try {
+        shm     = bip::shared_memory_object{bip::create_only, _name.c_str(), bip::read_write};
+        created = true;
+      } catch (const bip::interprocess_exception& e) {
+        if (e.get_error_code() != bip::already_exists_error) {
+          throw;
+        }
+
+        shm = bip::shared_memory_object{bip::open_only, _name.c_str(), bip::read_write};
+      }
+
+      if (created) {
+        shm.truncate(static_cast<bip::offset_t>(data_offset + capacity));
+      } else {
+        for (auto size = bip::offset_t{0}; shm.get_size(size), size == 0;) {
+          _wait_for_creator(give_up_at);
+        }
+      }
+
+      _region = bip::mapped_region{shm, bip::read_write};
+      _header = static_cast<header*>(_region.get_address());
+
+      if (created) {
+        _header->state.store(1);
+        _header->version  = version;
+        _header->capacity = std::min<std::uint64_t>(capacity, _region.get_size() - data_offset);
+        _header->state.store(2);
+      }
+
+      while (_header->state.load() != 2) {
+        _wait_for_creator(give_up_at);
+      }
+
+      if (_header->version != version) {
+        throw std::runtime_error{"incompatible shared memory ring: " + _name};
+      }
+
+      _capacity = _header->capacity;
+      _data     = static_cast<char*>(_region.get_address()) + data_offset;
+    }
+
+    ring(const ring&)            = delete;
+    ring& operator=(const ring&) = delete;
+
+    ~ring() {
+      if (_remove_on_close) {
+        boost::interprocess::shared_memory_object::remove(_name.c_str());
+      }
+    }
+
+    [[nodiscard]] std::size_t capacity() const noexcept { return _capacity; }
+
+    [[nodiscard]] std::size_t max_datagram_size() const noexcept { return _capacity / 2 - length_size; }
+
+    // Waits for space if the ring is full. Returns false if cancelled becomes true while waiting.
+    bool write(std::span<const char> datagram, const std::atomic_bool& cancelled) {
+      return _write(datagram, prepare(datagram.size(), cancelled));
+    }
+
+    // Returns false straight away, without writing anything, if the ring is full.
+    bool try_write(std::span<const char> datagram) { return _write(datagram, try_prepare(datagram.size())); }
+
+    // Waits for room for a datagram of up to n bytes, and returns that room, in the ring itself, so that the datagram can be
+    // built in place. The reader doesn't see any of it until commit() is called, and nothing else can be written until then.
+    // Returns nothing if cancelled becomes true while waiting.
+    [[nodiscard]] std::optional<std::span<char>> prepare(std::size_t n, const std::atomic_bool& cancelled) {
+      return _prepare(n, &cancelled);
+    }
+
+    // Like prepare(), but returns nothing straight away if there isn't room yet.
+    [[nodiscard]] std::optional<std::span<char>> try_prepare(std::size_t n) { return _prepare(n, nullptr); }
+
+    // Hands the first n bytes of the room that prepare() returned to the reader, as one datagram.
+    void commit(std::size_t n) {
+      const auto prepared = std::exchange(_prepared, std::nullopt);
+      if (not prepared) {
+        throw std::logic_error{"commit() was called without prepare()"};
+      }
+
+      if (n > *prepared) {
+        throw std::length_error{"committed more data than was prepared"};
+      }
+
+      _put_length(_prepared_head % _capacity, static_cast<std::uint32_t>(n));
+      _header->head.store(_prepared_head + _record_size(n), std::memory_order_release);
+
+      _header->data_seq.fetch_add(1);
+      if (_header->reader_waiting.load()) {
+        wake_all(_header->data_seq);
+      }
+    }
+
+    // Returns the oldest datagram in the ring, in place, without consuming it.
+    [[nodiscard]] std::optional<std::span<const char>> peek() {
+      while (true) {
+        const auto tail = _header->tail.load(std::memory_order_relaxed);
+        if (tail == _header->head.load(std::memory_order_acquire)) {
+          return std::nullopt;
+        }
+
+        const auto pos = tail % _capacity;
+        const auto len = _get_length(pos);
+        if (len != wrap_marker) {
+          return std::span<const char>{_data + pos + length_size, len};
+        }
+
+        _consume(_capacity - pos);
+      }
+    }
+
+    // Consumes the datagram that peek() returned.
+    void pop(std::span<const char> datagram) { _consume(_record_size(datagram.size())); }
+
+    // Waits until there's something to read. Returns false if cancelled becomes true first.
+    bool wait_for_data(const std::atomic_bool& cancelled) {
+      while (not cancelled.load()) {
+        _header->reader_waiting.store(1);
+        const auto seq = _header->data_seq.load();
+        if (_header->tail.load() != _header->head.load()) {
+          _header->reader_waiting.store(0);
+          return true;
+        }
+
+        wait_on(_header->data_seq, seq, wait_slice);
+        _header->reader_waiting.store(0);
+      }
+
+      return false;
+    }
+
+    // Unblocks anything in this process that's waiting on the ring, so that it can notice that it's been cancelled.
+    void interrupt() {
+      _header->data_seq.fetch_add(1);
+      _header->space_seq.fetch_add(1);
+      wake_all(_header->data_seq);
+      wake_all(_header->space_seq);
+    }
+
+   private:
+    void _wait_for_creator(std::chrono::steady_clock::time_point give_up_at) const {
+      if (std::chrono::steady_clock::now() >= give_up_at) {
+        throw std::runtime_error{"shared memory ring was never initialised: " + _name};
+      }
+
+      std::this_thread::sleep_for(1ms);
+    }
+
+    // Without a cancelled flag to watch, this doesn't wait at all.
+    [[nodiscard]] std::optional<std::span<char>> _prepare(std::size_t n, const std::atomic_bool* cancelled) {
+      if (n > max_datagram_size()) {
+        throw std::length_error{"datagram is too big for the shared memory ring"};
+      }
+
+      const auto record = _record_size(n);
+      auto head         = _header->head.load(std::memory_order_relaxed);
+      const auto pos    = head % _capacity;
+      const auto to_end = _capacity - pos;
+      const auto needed = record + (to_end < record ? to_end : 0);
+
+      while (_capacity - (head - _header->tail.load(std::memory_order_acquire)) < needed) {
+        if (not cancelled or cancelled->load()) {
+          return std::nullopt;
+        }
+
+        _header->writer_waiting.store(1);
+        const auto seq = _header->space_seq.load();
+        if (_capacity - (head - _header->tail.load()) < needed) {
+          wait_on(_header->space_seq, seq, wait_slice);
+        }
+        _header->writer_waiting.store(0);
+      }
+
+      // The reader stops at head, so the wrap marker isn't seen until the datagram after it is committed.
+      if (to_end < record) {
+        _put_length(pos, wrap_marker);
+        head += to_end;
+      }
+
+      _prepared_head = head;
+      _prepared      = n;
+      return std::span<char>{_data + head % _capacity + length_size, n};
+    }
+
+    bool _write(std::span<const char> datagram, std::optional<std::span<char>> space) {
+      if (not space) {
+        return false;
+      }
+
+      std::memcpy(space->data(), datagram.data(), datagram.size());
+      commit(datagram.size());
+      return true;
+    }
+
+    void _consume(std::size_t n) {
+      _header->tail.store(_header->tail.load(std::memory_order_relaxed) + n, std::memory_order_release);
+
+      _header->space_seq.fetch_add(1);
+      if (_header->writer_waiting.load()) {
+        wake_all(_header->space_seq);
+      }
+    }
+
+    void _put_length(std::size_t pos, std::uint32_t len) noexcept { std::memcpy(_data + pos, &len, length_size); }
+
+    [[nodiscard]] std::uint32_t _get_length(std::size_t pos) const noexcept {
+      auto len = std::uint32_t{0};
+      std::memcpy(&len, _data + pos, length_size);
+      return len;
+    }
+
+    std::string _name;
+    bool _remove_on_close;
+    boost::interprocess::mapped_region _region{};
+    header* _header{nullptr};
+    std::size_t _capacity{0};
+    char* _data{nullptr};
+
+    // Where the datagram that prepare() made room for starts, and how big it can be.
+    std::uint64_t _prepared_head{0};
+    std::optional<std::size_t> _prepared{};
+  };
+
+}  // namespace detail
+
+}  // namespace nsl::shm
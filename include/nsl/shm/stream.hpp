@@ -0,0 +1,18 @@
+#pragma once
+
+#include <nsl/shm/istream.hpp>
+#include <nsl/shm/ostream.hpp>
+
+namespace nsl::shm {
+
+// Each direction is its own ring, so a pair of peers use each other's local channel as their remote one.
+class stream : public istream, public ostream {
+ public:
+  explicit stream(boost::asio::io_context& io,
+                  std::string local_channel,
+                  std::string remote_channel,
+                  std::size_t capacity = default_capacity)
+      : istream{io, std::move(local_channel), capacity}, ostream{io, std::move(remote_channel), capacity} {}
+};
+
+}  // namespace nsl::shm
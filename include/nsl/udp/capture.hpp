@@ -0,0 +1,303 @@
+#pragma once
+
+#include "istream.hpp"
+#include "ostream.hpp"
+#include "types.hpp"
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <tuple>
+
+namespace nsl::udp {
+
+// Capture files are a file header followed by one record per datagram, in the order they were received. Each record is a
+// record header followed by the datagram itself, with no padding. All integers are in the host's byte order. The file is
+// bigger than its records until the writer's closed, so the header says where the last complete record ends.
+namespace capture_format {
+
+  constexpr auto magic   = std::array<char, 8>{'N', 'S', 'L', 'C', 'A', 'P', 'T', 'R'};
+  constexpr auto version = std::uint32_t{2};
+
+  struct file_header {
+    std::array<char, 8> magic;
+    std::uint32_t version;
+    std::uint32_t reserved;
+    std::uint64_t committed;  // The offset, from the start of the file, of the end of the last record written.
+  };
+
+  struct record_header {
+    std::uint64_t timestamp_ns;  // Since the capture started.
+    std::uint32_t size;
+  };
+
+  constexpr auto committed_offset   = sizeof(file_header::magic) + sizeof(file_header::version) + sizeof(file_header::reserved);
+  constexpr auto file_header_size   = committed_offset + sizeof(file_header::committed);
+  constexpr auto record_header_size = sizeof(record_header::timestamp_ns) + sizeof(record_header::size);
+
+}  // namespace capture_format
+
+struct capture_record {
+  std::chrono::nanoseconds timestamp;
+  std::span<const char> data;
+};
+
+// Appends datagrams to a memory-mapped capture file. The file is grown as needed and trimmed to fit when the writer is
+// closed. Each record is committed in the file header once it's been written, so a capture whose writer never got to
+// close it (because its process died, say) can still be read. A single writer can be shared between several istreams.
+class capture_writer {
+ public:
+  explicit capture_writer(std::filesystem::path path, std::size_t initial_capacity = std::size_t{1} << 20)
+      : _path{std::move(path)}, _start{std::chrono::steady_clock::now()} {
+    if (not std::ofstream{_path, std::ios::binary | std::ios::trunc}) {
+      throw std::runtime_error{"failed to create capture file: " + _path.string()};
+    }
+
+    _map(std::max(initial_capacity, capture_format::file_header_size));
+
+    const auto header = capture_format::file_header{capture_format::magic, capture_format::version, 0, 0};
+    _put(header.magic.data(), header.magic.size());
+    _put(&header.version, sizeof(header.version));
+    _put(&header.reserved, sizeof(header.reserved));
+    _put(&header.committed, sizeof(header.committed));
+    _commit();
+  }
+
+  capture_writer(const capture_writer&)            = delete;
+  capture_writer& operator=(const capture_writer&) = delete;
+
+  // A file that can't be trimmed is left at its mapped size, which a reader copes with because of the committed size.
+  ~capture_writer() { std::ignore = _close(); }
+
+  void append(std::span<const char> datagram) {
+    const auto timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _start);
+    const auto header    = capture_format::record_header{static_cast<std::uint64_t>(timestamp.count()),
+                                                         static_cast<std::uint32_t>(datagram.size())};
+
+    auto _ = std::unique_lock{_mtx};
+    if (not _region.get_address()) {
+      return;
+    }
+
+    const auto record_size = capture_format::record_header_size + datagram.size();
+    if (_used + record_size > _region.get_size()) {
+      _map(std::max(_region.get_size() * 2, _used + record_size));
+    }
+
+    _put(&header.timestamp_ns, sizeof(header.timestamp_ns));
+    _put(&header.size, sizeof(header.size));
+    _put(datagram.data(), datagram.size());
+    _commit();
+
+    ++_record_count;
+  }
+
+  // Records everything that the stream receives from now on. The writer must outlive the stream's reads.
+  void attach(istream& is) {
+    is.set_receive_tap([this](std::span<const char> datagram) { append(datagram); });
+  }
+
+  [[nodiscard]] std::size_t size() const {
+    auto _ = std::unique_lock{_mtx};
+    return _record_count;
+  }
+
+  // Throws std::filesystem::filesystem_error if the file can't be trimmed to its records. The writer is closed regardless.
+  void close() {
+    if (const auto ec = _close()) {
+      throw std::filesystem::filesystem_error{"failed to trim capture file", _path, ec};
+    }
+  }
+
+ private:
+  [[nodiscard]] std::error_code _close() noexcept {
+    auto _ = std::unique_lock{_mtx};
+    if (not _region.get_address()) {
+      return {};
+    }
+
+    _region.flush();
+    _region = boost::interprocess::mapped_region{};
+    _file   = boost::interprocess::file_mapping{};
+
+    auto ec = std::error_code{};
+    std::filesystem::resize_file(_path, _used, ec);
+    return ec;
+  }
+
+  void _map(std::size_t capacity) {
+    if (_region.get_address()) {
+      _region.flush();
+      _region = boost::interprocess::mapped_region{};
+      _file   = boost::interprocess::file_mapping{};
+    }
+
+    std::filesystem::resize_file(_path, capacity);
+    _file   = boost::interprocess::file_mapping{_path.string().c_str(), boost::interprocess::read_write};
+    _region = boost::interprocess::mapped_region{_file, boost::interprocess::read_write};
+  }
+
+  void _put(const void* data, std::size_t n) {
+    std::memcpy(static_cast<char*>(_region.get_address()) + _used, data, n);
+    _used += n;
+  }
+
+  // Marks everything that's been put so far as part of the capture.
+  void _commit() {
+    const auto committed = static_cast<std::uint64_t>(_used);
+    std::memcpy(static_cast<char*>(_region.get_address()) + capture_format::committed_offset, &committed, sizeof(committed));
+  }
+
+  std::filesystem::path _path;
+  std::chrono::steady_clock::time_point _start;
+  mutable std::mutex _mtx;
+  boost::interprocess::file_mapping _file{};
+  boost::interprocess::mapped_region _region{};
+  std::size_t _used{0};
+  std::size_t _record_count{0};
+};
+
+// Maps a capture file read-only. The records that it yields point straight into the mapping, so they're only valid for as
+// long as the reader is.
+class capture_reader {
+ public:
+  class const_iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type        = capture_record;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = const capture_record*;
+    using reference         = const capture_record&;
+
+    const_iterator() = default;
+
+    [[nodiscard]] reference operator*() const { return _record; }
+    [[nodiscard]] pointer operator->() const { return &_record; }
+
+    const_iterator& operator++() {
+      _pos = _record.data.data() + _record.data.size();
+      _load();
+      return *this;
+    }
+
+    const_iterator operator++(int) {
+      auto prev = *this;
+      ++(*this);
+      return prev;
+    }
+
+    [[nodiscard]] bool operator==(const const_iterator& other) const { return _pos == other._pos; }
+
+   private:
+    friend class capture_reader;
+
+    const_iterator(const char* pos, const char* end) : _pos{pos}, _end{end} { _load(); }
+
+    void _load() {
+      if (_pos == _end) {
+        return;
+      }
+
+      if (static_cast<std::size_t>(_end - _pos) < capture_format::record_header_size) {
+        throw std::runtime_error{"truncated capture record"};
+      }
+
+      auto header = capture_format::record_header{};
+      std::memcpy(&header.timestamp_ns, _pos, sizeof(header.timestamp_ns));
+      std::memcpy(&header.size, _pos + sizeof(header.timestamp_ns), sizeof(header.size));
+
+      const auto data = _pos + capture_format::record_header_size;
+      if (static_cast<std::size_t>(_end - data) < header.size) {
+        throw std::runtime_error{"truncated capture record"};
+      }
+
+      _record = capture_record{std::chrono::nanoseconds{header.timestamp_ns}, {data, header.size}};
+    }
+
+    const char* _pos{nullptr};
+    const char* _end{nullptr};
+    capture_record _record{};
+  };
+
+  explicit capture_reader(const std::filesystem::path& path) {
+    if (std::filesystem::file_size(path) < capture_format::file_header_size) {
+      throw std::runtime_error{"not an NSL capture file: " + path.string()};
+    }
+
+    _file   = boost::interprocess::file_mapping{path.string().c_str(), boost::interprocess::read_only};
+    _region = boost::interprocess::mapped_region{_file, boost::interprocess::read_only};
+
+    auto header = capture_format::file_header{};
+    std::memcpy(header.magic.data(), _data(), header.magic.size());
+    std::memcpy(&header.version, _data() + header.magic.size(), sizeof(header.version));
+
+    if (header.magic != capture_format::magic or header.version != capture_format::version) {
+      throw std::runtime_error{"not an NSL capture file: " + path.string()};
+    }
+
+    // Anything after the last committed record is space that the writer hadn't filled yet.
+    std::memcpy(&header.committed, _data() + capture_format::committed_offset, sizeof(header.committed));
+    if (header.committed < capture_format::file_header_size or header.committed > _region.get_size()) {
+      throw std::runtime_error{"truncated capture file: " + path.string()};
+    }
+
+    _committed = static_cast<std::size_t>(header.committed);
+  }
+
+  [[nodiscard]] const_iterator begin() const {
+    return const_iterator{_data() + capture_format::file_header_size, _data() + _committed};
+  }
+
+  [[nodiscard]] const_iterator end() const {
+    const auto end = _data() + _committed;
+    return const_iterator{end, end};
+  }
+
+ private:
+  [[nodiscard]] const char* _data() const { return static_cast<const char*>(_region.get_address()); }
+
+  boost::interprocess::file_mapping _file{};
+  boost::interprocess::mapped_region _region{};
+  std::size_t _committed{0};
+};
+
+enum class replay_timing {
+  original,            // Keep the gaps between datagrams that there were when they were captured.
+  as_fast_as_possible  // Send each datagram as soon as the previous one has gone.
+};
+
+// Sends each captured datagram, straight out of the mapped file, as a single datagram on the stream's socket. Blocks until
+// the whole capture has been sent and returns the number of datagrams sent.
+inline std::size_t replay(const capture_reader& capture, ostream& os, replay_timing timing = replay_timing::original) {
+  const auto start = std::chrono::steady_clock::now();
+  const auto first = capture.begin() == capture.end() ? std::chrono::nanoseconds{0} : capture.begin()->timestamp;
+
+  auto sent = std::size_t{0};
+  for (const auto& record : capture) {
+    if (timing == replay_timing::original) {
+      std::this_thread::sleep_until(start + (record.timestamp - first));
+    }
+
+    std::ignore = os->write(record.data.data(), static_cast<std::streamsize>(record.data.size()));
+    ++sent;
+  }
+
+  return sent;
+}
+
+}  // namespace nsl::udp
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <boost/endian/conversion.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/stream.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace nsl::udp {
+
+namespace detail {
+
+  // Each message in a coalesced datagram is prefixed with its length, as a 2-byte big-endian number.
+  using frame_length                = std::uint16_t;
+  constexpr auto frame_header_size  = sizeof(frame_length);
+  constexpr auto max_framed_message = std::size_t{std::numeric_limits<frame_length>::max()};
+
+  // Writes the length of a message of n bytes to dest, which must have room for frame_header_size bytes.
+  inline void write_frame_length(char* dest, std::size_t n) {
+    if (n > max_framed_message) {
+      throw std::length_error{"message is too long to be coalesced"};
+    }
+
+    const auto length = boost::endian::native_to_big(static_cast<frame_length>(n));
+    std::memcpy(dest, &length, frame_header_size);
+  }
+
+  // The datagram that messages are being packed into. Its buffer is allocated up front, and only grows if a single message
+  // is too big to fit in a datagram of max_datagram_size on its own (in which case it's sent on its own).
+  class coalescer {
+   public:
+    explicit coalescer(coalesce_options opts) : _opts{opts} { _datagram.reserve(_opts.max_datagram_size); }
+
+    [[nodiscard]] const coalesce_options& options() const noexcept { return _opts; }
+
+    [[nodiscard]] bool empty() const noexcept { return _datagram.empty(); }
+
+    [[nodiscard]] bool fits(std::size_t n) const noexcept {
+      return _datagram.size() + frame_header_size + n <= _opts.max_datagram_size;
+    }
+
+    [[nodiscard]] bool full() const noexcept { return not fits(0); }
+
+    // When the first message in the datagram was added.
+    [[nodiscard]] std::chrono::steady_clock::time_point started() const noexcept { return _started; }
+
+    void append(const char* s, std::size_t n) {
+      if (n > max_framed_message) {
+        throw std::length_error{"message is too long to be coalesced"};
+      }
+
+      if (_datagram.empty()) {
+        _started = std::chrono::steady_clock::now();
+      }
+
+      const auto offset = _datagram.size();
+      _datagram.resize(offset + frame_header_size + n);
+      write_frame_length(_datagram.data() + offset, n);
+      std::memcpy(_datagram.data() + offset + frame_header_size, s, n);
+    }
+
+    [[nodiscard]] std::span<const char> datagram() const noexcept { return _datagram; }
+
+    void clear() noexcept { _datagram.clear(); }
+
+   private:
+    coalesce_options _opts;
+    std::vector<char> _datagram;
+    std::chrono::steady_clock::time_point _started{};
+  };
+
+}  // namespace detail
+
+// Wraps a receive callback so that each message in a coalesced datagram is handed to it separately. A message whose length
+// runs past the end of the datagram (because the datagram was truncated, say) is dropped, along with anything after it.
+// Datagrams can be deframed on several threads at once (under dispatch_to(), say), so the callback has to cope with that.
+template <async_recv_fn_like Callback_T>
+class deframed_recv_fn {
+ public:
+  explicit deframed_recv_fn(Callback_T callback) : _state{std::make_shared<state>(std::move(callback))} {}
+
+  void operator()(std::istream& is, size_t n) {
+    // One buffer per thread, so that it's only allocated while datagrams are getting bigger, and datagrams that are being
+    // deframed on different threads don't share it.
+    thread_local auto datagram = std::vector<char>{};
+    datagram.resize(n);
+    is.read(datagram.data(), static_cast<std::streamsize>(n));
+    n = static_cast<size_t>(is.gcount());
+
+    for (auto offset = std::size_t{0}; n - offset >= detail::frame_header_size;) {
+      auto length = detail::frame_length{0};
+      std::memcpy(&length, datagram.data() + offset, detail::frame_header_size);
+      boost::endian::big_to_native_inplace(length);
+      offset += detail::frame_header_size;
+
+      if (length > n - offset) {
+        return;
+      }
+
+      auto message = boost::iostreams::stream<boost::iostreams::array_source>{datagram.data() + offset, length};
+      _state->callback(message, length);
+      offset += length;
+    }
+  }
+
+ private:
+  struct state {
+    explicit state(Callback_T cb) : callback{std::move(cb)} {}
+
+    Callback_T callback;
+  };
+
+  std::shared_ptr<state> _state;
+};
+
+template <async_recv_fn_like Callback_T>
+[[nodiscard]] deframed_recv_fn<std::decay_t<Callback_T>> deframed(Callback_T&& callback) {
+  return deframed_recv_fn<std::decay_t<Callback_T>>{std::forward<Callback_T>(callback)};
+}
+
+}  // namespace nsl::udp
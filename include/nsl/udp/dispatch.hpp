@@ -0,0 +1,110 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <boost/asio/ip/udp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/thread_pool.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace nsl::udp {
+
+// A pool of threads that received datagrams can be handed off to, so that slow callbacks don't hold up the receive loop.
+class worker_pool {
+ public:
+  using executor_type = boost::asio::thread_pool::executor_type;
+
+  explicit worker_pool(std::size_t thread_count = std::thread::hardware_concurrency())
+      : _thread_count{std::max(thread_count, std::size_t{1})}, _pool{_thread_count} {}
+
+  worker_pool(const worker_pool&)            = delete;
+  worker_pool& operator=(const worker_pool&) = delete;
+
+  [[nodiscard]] std::size_t size() const noexcept { return _thread_count; }
+
+  [[nodiscard]] executor_type get_executor() noexcept { return _pool.get_executor(); }
+
+  // Waits for all the work that has been handed to the pool to finish.
+  void join() { _pool.join(); }
+
+ private:
+  std::size_t _thread_count;
+  boost::asio::thread_pool _pool;
+};
+
+template <async_recv_fn_like Callback_T>
+struct dispatched_recv_fn {
+  worker_pool& pool;
+  Callback_T callback;
+};
+
+// Wraps an async receive callback so that it's run on the worker pool instead of the io thread. Datagrams from the same
+// sender are delivered in order and one at a time; datagrams from different senders may be handled concurrently, so the
+// callback must be safe to call from several threads at once.
+template <async_recv_fn_like Callback_T>
+[[nodiscard]] dispatched_recv_fn<std::decay_t<Callback_T>> dispatch_to(worker_pool& pool, Callback_T&& callback) {
+  return {pool, std::forward<Callback_T>(callback)};
+}
+
+namespace detail {
+
+  // Each sender is hashed onto one of a fixed set of strands, which keeps the per-sender ordering without having to track
+  // every sender that we've ever seen.
+  class sender_strands {
+   public:
+    using strand_type = boost::asio::strand<worker_pool::executor_type>;
+
+    explicit sender_strands(worker_pool& pool) {
+      const auto strand_count = pool.size() * strands_per_thread;
+
+      _strands.reserve(strand_count);
+      std::generate_n(std::back_inserter(_strands), strand_count, [&pool]() { return strand_type{pool.get_executor()}; });
+    }
+
+    template <typename Endpoint_T>
+    [[nodiscard]] const strand_type& operator[](const Endpoint_T& sender) const {
+      return _strands[_hash(sender) % _strands.size()];
+    }
+
+   private:
+    [[nodiscard]] static std::size_t _hash(const boost::asio::ip::udp::endpoint& sender) {
+      const auto addr = sender.address();
+
+      auto h = std::size_t{0};
+      if (addr.is_v4()) {
+        h = std::hash<std::uint32_t>{}(addr.to_v4().to_uint());
+      } else {
+        const auto bytes = addr.to_v6().to_bytes();
+        h = std::hash<std::string_view>{}(std::string_view{reinterpret_cast<const char*>(bytes.data()), bytes.size()});
+      }
+
+      return (h * 31) ^ std::hash<port_number>{}(sender.port());
+    }
+
+    // Local (Unix domain) senders are identified by the path they're bound to, which is empty if they aren't bound.
+    template <typename Endpoint_T>
+      requires requires(const Endpoint_T& e) { e.path(); }
+    [[nodiscard]] static std::size_t _hash(const Endpoint_T& sender) {
+      return std::hash<std::string>{}(sender.path());
+    }
+
+    static constexpr auto strands_per_thread = std::size_t{4};
+
+    std::vector<strand_type> _strands;
+  };
+
+}  // namespace detail
+
+}  // namespace nsl::udp
@@ -0,0 +1,196 @@
+#pragma once
+
+#include "ostream.hpp"
+#include "resolve.hpp"
+#include "types.hpp"
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/iostreams/stream.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <cerrno>
+#endif
+
+namespace nsl::udp {
+
+namespace detail {
+
+  // Sends every datagram that's written to it to each of a set of subscribers, from one socket. The subscribers are held in
+  // an immutable list that's swapped out whenever one is added or removed, so a send only holds the lock for long enough to
+  // take a reference to the current list.
+  class fanout_sink {
+    using endpoint_type   = boost::asio::ip::udp::endpoint;
+    using subscriber_list = std::vector<endpoint_type>;
+
+    struct kernel {
+      explicit kernel(boost::asio::io_context& io) : socket{io, endpoint_type{boost::asio::ip::udp::v4(), 0}} {}
+
+      boost::asio::ip::udp::socket socket;
+
+      mutable std::mutex subscribers_mtx;
+      std::shared_ptr<const subscriber_list> subscribers{std::make_shared<const subscriber_list>()};
+
+      std::atomic<std::uint64_t> failed_sends{0};
+
+#if defined(__linux__)
+      // Reused from one datagram to the next, so that sending doesn't allocate once the subscriber list has stopped growing.
+      std::vector<mmsghdr> messages{};
+#endif
+    };
+
+   public:
+    using char_type = char;
+    using category  = boost::iostreams::sink_tag;
+
+    explicit fanout_sink(boost::asio::io_context& io) : _kernel{std::make_shared<kernel>(io)} {}
+
+    fanout_sink()                              = delete;
+    fanout_sink(const fanout_sink&)            = default;
+    fanout_sink& operator=(const fanout_sink&) = delete;
+    fanout_sink(fanout_sink&&)                 = default;
+    fanout_sink& operator=(fanout_sink&&)      = default;
+
+    // A send that fails for one subscriber doesn't stop the others from getting the datagram; it's counted in failed_sends().
+    [[nodiscard]] std::streamsize write(const char* s, std::streamsize n) {
+      const auto subscribers = _snapshot();
+      _send_to_all(*subscribers, s, static_cast<std::size_t>(n));
+
+      return n;
+    }
+
+    // Returns false if the endpoint is already subscribed.
+    bool add_subscriber(const endpoint_type& endpoint) {
+      auto _              = std::unique_lock{_kernel->subscribers_mtx};
+      const auto& current = *_kernel->subscribers;
+      if (std::find(current.begin(), current.end(), endpoint) != current.end()) {
+        return false;
+      }
+
+      auto updated = std::make_shared<subscriber_list>(current);
+      updated->push_back(endpoint);
+      _kernel->subscribers = std::move(updated);
+      return true;
+    }
+
+    // Returns false if the endpoint wasn't subscribed. A datagram that's already being sent may still reach it.
+    bool remove_subscriber(const endpoint_type& endpoint) {
+      auto _              = std::unique_lock{_kernel->subscribers_mtx};
+      const auto& current = *_kernel->subscribers;
+      if (std::find(current.begin(), current.end(), endpoint) == current.end()) {
+        return false;
+      }
+
+      auto updated = std::make_shared<subscriber_list>();
+      updated->reserve(current.size() - 1);
+      std::copy_if(current.begin(), current.end(), std::back_inserter(*updated), [&](const auto& e) { return e != endpoint; });
+      _kernel->subscribers = std::move(updated);
+      return true;
+    }
+
+    [[nodiscard]] std::size_t subscriber_count() const { return _snapshot()->size(); }
+
+    [[nodiscard]] std::uint64_t failed_sends() const noexcept { return _kernel->failed_sends.load(); }
+
+   private:
+    [[nodiscard]] std::shared_ptr<const subscriber_list> _snapshot() const {
+      auto _ = std::unique_lock{_kernel->subscribers_mtx};
+      return _kernel->subscribers;
+    }
+
+#if defined(__linux__)
+    // All the messages share the one copy of the data, and are handed to the kernel with as few sendmmsg calls as possible.
+    void _send_to_all(const subscriber_list& subscribers, const char* s, std::size_t n) {
+      auto data      = iovec{const_cast<char*>(s), n};
+      auto& messages = _kernel->messages;
+      messages.resize(subscribers.size());
+
+      for (auto i = std::size_t{0}; i < subscribers.size(); ++i) {
+        messages[i]                     = mmsghdr{};
+        messages[i].msg_hdr.msg_name    = const_cast<sockaddr*>(subscribers[i].data());
+        messages[i].msg_hdr.msg_namelen = static_cast<socklen_t>(subscribers[i].size());
+        messages[i].msg_hdr.msg_iov     = &data;
+        messages[i].msg_hdr.msg_iovlen  = 1;
+      }
+
+      const auto fd = _kernel->socket.native_handle();
+      for (auto sent = std::size_t{0}; sent < messages.size();) {
+        const auto remaining = static_cast<unsigned int>(std::min<std::size_t>(messages.size() - sent, max_messages_per_call));
+        const auto result    = ::sendmmsg(fd, messages.data() + sent, remaining, 0);
+        if (result < 0) {
+          if (errno == EINTR) {
+            continue;
+          }
+
+          // sendmmsg only fails outright if the first message couldn't be sent, so skip over that one and carry on.
+          ++_kernel->failed_sends;
+          ++sent;
+          continue;
+        }
+
+        sent += static_cast<std::size_t>(result);
+      }
+    }
+
+    static constexpr auto max_messages_per_call = std::size_t{1024};
+#else
+    void _send_to_all(const subscriber_list& subscribers, const char* s, std::size_t n) {
+      const auto buf = boost::asio::buffer(s, n);
+      for (const auto& subscriber : subscribers) {
+        auto ec = boost::system::error_code{};
+        _kernel->socket.send_to(buf, subscriber, 0, ec);
+        if (ec) {
+          ++_kernel->failed_sends;
+        }
+      }
+    }
+#endif
+
+    std::shared_ptr<kernel> _kernel;
+  };
+
+}  // namespace detail
+
+// Formats each datagram once and sends it to every subscriber. Subscribers can be added and removed while datagrams are being
+// written, from any thread.
+class fanout_ostream : public boost::iostreams::stream<detail::fanout_sink>, public datagram_ostream<fanout_ostream> {
+ public:
+  explicit fanout_ostream(boost::asio::io_context& io)
+      : boost::iostreams::stream<detail::fanout_sink>{detail::fanout_sink{io}}, _io{io} {}
+
+  bool add_subscriber(std::string host, port_number port) {
+    return (*this)->add_subscriber(detail::resolve_endpoint(_io, std::move(host), port));
+  }
+
+  bool add_subscriber(const boost::asio::ip::udp::endpoint& endpoint) { return (*this)->add_subscriber(endpoint); }
+
+  bool remove_subscriber(std::string host, port_number port) {
+    return (*this)->remove_subscriber(detail::resolve_endpoint(_io, std::move(host), port));
+  }
+
+  bool remove_subscriber(const boost::asio::ip::udp::endpoint& endpoint) { return (*this)->remove_subscriber(endpoint); }
+
+  [[nodiscard]] std::size_t subscriber_count() { return (*this)->subscriber_count(); }
+
+  [[nodiscard]] std::uint64_t failed_sends() { return (*this)->failed_sends(); }
+
+ private:
+  boost::asio::io_context& _io;
+};
+
+}  // namespace nsl::udp
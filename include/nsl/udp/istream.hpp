@@ -1,26 +1,55 @@
 #pragma once
 
+#include "dispatch.hpp"
+#include "probe.hpp"
+#include "receive_ring.hpp"
+#include "resolve.hpp"
 #include "types.hpp"
 
+#include <boost/asio/bind_cancellation_slot.hpp>
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/cancellation_signal.hpp>
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/ip/udp.hpp>
+#include <boost/asio/strand.hpp>
 #include <boost/asio/streambuf.hpp>
 #include <boost/iostreams/device/array.hpp>
 #include <boost/iostreams/device/back_inserter.hpp>
 #include <boost/iostreams/stream.hpp>
+#include <boost/system/system_error.hpp>
 
 #include <wite/core/scope.hpp>
 
+#include <array>
 #include <atomic>
+#include <cerrno>
 #include <chrono>
 #include <condition_variable>
 #include <cstdint>
+#include <filesystem>
+#include <functional>
 #include <istream>
+#include <limits>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <span>
 #include <string>
 #include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#endif
+#endif
 
 namespace boost::asio {
 class io_context;
@@ -30,40 +59,187 @@ namespace nsl::udp {
 
 namespace detail {
 
-  class source {
+  // The file that a local socket is bound to, if there is one. Abstract names (which start with a nul) aren't files.
+  template <typename Endpoint_T>
+  [[nodiscard]] std::filesystem::path socket_file(const Endpoint_T& endpoint) {
+    if constexpr (requires { endpoint.path(); }) {
+      if (auto path = endpoint.path(); not path.empty() and path.front() != '\0') {
+        return path;
+      }
+    }
+
+    return {};
+  }
+
+  // Only ever removes a socket, so that a path given by mistake can't cost anyone a file.
+  inline void remove_socket_file(const std::filesystem::path& path) {
+    if (auto ec = std::error_code{}; not path.empty() and std::filesystem::is_socket(path, ec)) {
+      std::filesystem::remove(path, ec);
+    }
+  }
+
+  // Filesystem sockets are left behind by the process that bound them, so any stale one is cleared out before binding. If
+  // something other than a socket is at the path, it's left alone, and binding fails with address_in_use.
+  template <typename Endpoint_T>
+  [[nodiscard]] std::shared_ptr<typename Endpoint_T::protocol_type::socket> bind_socket(boost::asio::io_context& io,
+                                                                                       const Endpoint_T& endpoint) {
+    remove_socket_file(socket_file(endpoint));
+    return std::make_shared<typename Endpoint_T::protocol_type::socket>(io, endpoint);
+  }
+
+  // What cancel_sync_read() pokes to wake a blocking read from its poll(). It's an eventfd on Linux and a pipe on other POSIX
+  // systems. Winsock's poll() only waits on sockets, so on Windows it's a loopback UDP socket that sends to itself.
+  class wakeup_channel {
+   public:
+#if defined(_WIN32)
+    using native_handle_type = boost::asio::ip::udp::socket::native_handle_type;
+
+    explicit wakeup_channel(boost::asio::io_context& io)
+        : _socket{io, boost::asio::ip::udp::endpoint{boost::asio::ip::address_v4::loopback(), 0}} {
+      _socket.non_blocking(true);
+    }
+
+    [[nodiscard]] native_handle_type native_handle() { return _socket.native_handle(); }
+
+    void poke() {
+      auto ec          = boost::system::error_code{};
+      const auto poke  = char{0};
+      const auto local = _socket.local_endpoint(ec);
+      if (not ec) {
+        _socket.send_to(boost::asio::buffer(&poke, 1), local, 0, ec);
+      }
+    }
+
+    void drain() {
+      auto ec   = boost::system::error_code{};
+      auto poke = char{0};
+      while (not ec) {
+        _socket.receive(boost::asio::buffer(&poke, 1), 0, ec);
+      }
+    }
+
+   private:
+    boost::asio::ip::udp::socket _socket;
+#else
+    using native_handle_type = int;
+
+    explicit wakeup_channel([[maybe_unused]] boost::asio::io_context& io) {
+#if defined(__linux__)
+      _fds[0] = _fds[1] = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+      if (_fds[0] < 0) {
+        throw boost::system::system_error{errno, boost::asio::error::get_system_category()};
+      }
+#else
+      if (::pipe(_fds.data()) != 0) {
+        throw boost::system::system_error{errno, boost::asio::error::get_system_category()};
+      }
+
+      for (const auto fd : _fds) {
+        ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+      }
+#endif
+    }
+
+    wakeup_channel(const wakeup_channel&)            = delete;
+    wakeup_channel& operator=(const wakeup_channel&) = delete;
+
+    ~wakeup_channel() {
+      ::close(_fds[0]);
+      if (_fds[1] != _fds[0]) {
+        ::close(_fds[1]);
+      }
+    }
+
+    [[nodiscard]] native_handle_type native_handle() const noexcept { return _fds[0]; }
+
+    // An eventfd only takes writes of 8 bytes, so that's what's written, to either kind.
+    void poke() noexcept {
+      const auto one = std::uint64_t{1};
+      [[maybe_unused]] const auto written = ::write(_fds[1], &one, sizeof(one));
+    }
+
+    void drain() noexcept {
+      auto buf = std::array<char, 64>{};
+      while (::read(_fds[0], buf.data(), buf.size()) > 0) {
+      }
+    }
+
+   private:
+    std::array<int, 2> _fds{-1, -1};  // The read end, and then the write end, which is the same eventfd on Linux.
+#endif
+  };
+
+  // The receiving end of a datagram socket. Protocol_T is the Asio protocol (boost::asio::ip::udp, or
+  // boost::asio::local::datagram_protocol) that the socket speaks. The socket can be shared with a basic_sink, so that
+  // both directions use the same local address; the socket is closed when the last of them lets go of it. Receives are
+  // cancelled one operation at a time, rather than by cancelling the socket, so that cancelling a read doesn't abort the
+  // sink's sends.
+  template <typename Protocol_T>
+  class basic_source {
+    using endpoint_type = typename Protocol_T::endpoint;
+    using socket_type   = typename Protocol_T::socket;
+
     struct kernel {
-      kernel(boost::asio::io_context& io, boost::asio::ip::udp::endpoint endpoint) : io{io}, socket{io, endpoint} {}
+      kernel(boost::asio::io_context& io, std::shared_ptr<socket_type> socket)
+          : socket_path{socket_file(socket->local_endpoint())}, io{io}, socket{std::move(socket)} {}
 
+      // A sink that shares the socket can outlive this, and carry on sending, so only this source's receives are cancelled.
       ~kernel() {
-        if (socket.is_open()) {
-          socket.close();
+        {
+          auto _ = std::unique_lock{mtx};
+          for (auto& signal : receive_cancels) {
+            signal->emit(boost::asio::cancellation_type::terminal);
+          }
         }
+
+        remove_socket_file(socket_path);
       }
 
+      std::filesystem::path socket_path;
       boost::asio::io_context& io;
-      boost::asio::ip::udp::socket socket;
-      static constexpr auto recv_buf_size = 4096;
+      std::shared_ptr<socket_type> socket;
+      static constexpr auto recv_buf_size = max_datagram_size;
       boost::asio::streambuf recv_data{};
       std::atomic_bool async_read_in_progress{false};
       std::atomic_bool sync_read_in_progress{false};
+      std::atomic_bool sync_read_cancelled{false};
       std::mutex mtx;
       std::condition_variable exiting_async_read;
+      bool stopping_async_read{false};  // Guarded by mtx, as is...
+      bool async_read_stopped{false};   // ...this, and...
+
+      // ...these: one for each receive that can be waiting on the socket at once. They're only grown, so that a receive's slot
+      // stays put for as long as the receive does.
+      std::vector<std::unique_ptr<boost::asio::cancellation_signal>> receive_cancels{};
+
+      // ...and this, which cancel_sync_read() pokes to wake a blocking read from its poll(). It's only open while a blocking
+      // read is waiting, so that the stream otherwise holds just the one descriptor.
+      std::optional<wakeup_channel> wakeup{};
+
+      receive_tap tap{};
+
+      // If the latency probe is on, every datagram has a probe header, which is stripped off before the reader sees it.
+      std::shared_ptr<latency_histogram> probe{};
     };
 
    public:
     using char_type = char;
     using category  = boost::iostreams::source_tag;
 
-    explicit source(boost::asio::io_context& io, port_number port)
-        : _in_kernel{std::make_shared<kernel>(io, _resolve_endpoint(io, "0.0.0.0", port))} {}
+    explicit basic_source(boost::asio::io_context& io, const endpoint_type& endpoint)
+        : basic_source{io, bind_socket(io, endpoint)} {}
+
+    explicit basic_source(boost::asio::io_context& io, std::shared_ptr<socket_type> socket)
+        : _in_kernel{std::make_shared<kernel>(io, std::move(socket))} {}
 
-    source()                         = delete;
-    source(const source&)            = default;
-    source& operator=(const source&) = delete;
-    source(source&&)                 = default;
-    source& operator=(source&&)      = default;
+    basic_source()                               = delete;
+    basic_source(const basic_source&)            = default;
+    basic_source& operator=(const basic_source&) = delete;
+    basic_source(basic_source&&)                 = default;
+    basic_source& operator=(basic_source&&)      = default;
 
-    ~source() {}
+    ~basic_source() {}
 
     [[nodiscard]] std::streamsize read(char* s, std::streamsize n) {
       if (_in_kernel->async_read_in_progress) {
@@ -73,33 +249,101 @@ namespace detail {
       _in_kernel->sync_read_in_progress = true;
       auto _                         = wite::scope_exit{[this]() { _in_kernel->sync_read_in_progress = false; }};
 
-      auto bytes_recvd = _in_kernel->socket.receive(boost::asio::buffer(s, n));
+      while (true) {
+        auto ec = boost::system::error_code{};
+        if (not _wait_readable(std::chrono::steady_clock::time_point::max(), ec)) {
+          if (ec == boost::asio::error::operation_aborted) {
+            return -1;
+          }
+
+          throw boost::system::system_error{ec};
+        }
+
+        // If another reader of the socket took the datagram first, this goes back to waiting, rather than returning nothing
+        // (which would end the stream).
+        const auto bytes_recvd = _receive_one(s, static_cast<std::size_t>(n), ec);
+        if (ec == boost::asio::error::would_block) {
+          continue;
+        }
+
+        if (ec) {
+          throw boost::system::system_error{ec};
+        }
+
+        if (bytes_recvd) {
+          if (_in_kernel->tap) {
+            _in_kernel->tap({s, *bytes_recvd});
+          }
+
+          return static_cast<std::streamsize>(*bytes_recvd);
+        }
+      }
+    }
+
+    // Reads a datagram if there's one waiting, without blocking.
+    [[nodiscard]] recv_result try_read(char* s, std::size_t n) {
+      return _read_before(s, n, std::chrono::steady_clock::now(), recv_status::would_block);
+    }
+
+    template <typename Rep_T, typename Period_T>
+    [[nodiscard]] recv_result read_for(char* s, std::size_t n, std::chrono::duration<Rep_T, Period_T> timeout) {
+      return read_until(s, n, std::chrono::steady_clock::now() + timeout);
+    }
 
-      return bytes_recvd;
+    [[nodiscard]] recv_result read_until(char* s, std::size_t n, std::chrono::steady_clock::time_point deadline) {
+      return _read_before(s, n, deadline, recv_status::timed_out);
     }
 
     template <async_recv_fn_like Callback_T>
     bool async_read(Callback_T&& callback) {
-      if (_in_kernel->sync_read_in_progress.load()) {
+      if (not _start_async_read()) {
         return false;
       }
 
-      _in_kernel->async_read_in_progress = true;
-      auto recv_buf                   = _in_kernel->recv_data.prepare(_in_kernel->recv_buf_size);
+      // Receives are only started under the lock, so that they can't race with a cancel.
+      auto _ = std::unique_lock{_in_kernel->mtx};
+      _do_receive(std::forward<Callback_T>(callback));
+      return true;
+    }
 
-      _in_kernel->socket.async_receive(recv_buf, [this, cb = std::forward<Callback_T>(callback)](auto&& err, auto&& n) {
-        if (err) {
-          { auto lock = std::unique_lock{_in_kernel->mtx}; }
-          _in_kernel->exiting_async_read.notify_all();
-          return;
-        }
+    template <async_recv_fn_like Callback_T>
+    bool async_read(dispatched_recv_fn<Callback_T>&& dispatched) {
+      if (not _start_async_read()) {
+        return false;
+      }
+
+      auto _ = std::unique_lock{_in_kernel->mtx};
+      _do_dispatched_receive(std::make_shared<dispatch_state<Callback_T>>(dispatched.pool, std::move(dispatched.callback)));
+      return true;
+    }
 
-        async_read(_do_receive_and_handle_data(std::move(cb), n));
-      });
+    template <async_recv_fn_like Callback_T>
+    bool async_read(ring_recv_fn<Callback_T>&& ring) {
+      if (not _start_async_read()) {
+        return false;
+      }
+
+      auto state = std::make_shared<ring_state<Callback_T>>(_in_kernel->io, ring.options, std::move(ring.callback));
+
+      // All the receives are posted under the lock, so that a cancel can't slip in between them.
+      auto _ = std::unique_lock{_in_kernel->mtx};
+      for (auto slot = std::size_t{0}; slot < state->slots.depth(); ++slot) {
+        _do_ring_receive(state, slot);
+      }
 
       return true;
     }
 
+    // Measures the time from each sampled datagram being written to it being handed to the reader. The sender must have the
+    // probe enabled too. Turn this on before starting to read.
+    std::shared_ptr<latency_histogram> enable_latency_probe() {
+      _in_kernel->probe = std::make_shared<latency_histogram>();
+      return _in_kernel->probe;
+    }
+
+    // The tap is called on whichever thread is doing the receiving, so set it before starting to read.
+    void set_receive_tap(receive_tap tap) { _in_kernel->tap = std::move(tap); }
+
     void cancel_async_read() {
       if (not _in_kernel->async_read_in_progress.load()) {
         return;
@@ -117,18 +361,104 @@ namespace detail {
     }
 
    private:
-    [[nodiscard]] static boost::asio::ip::udp::endpoint _resolve_endpoint(boost::asio::io_context& io,
-                                                                          std::string host,
-                                                                          port_number port) {
-      boost::asio::ip::udp::resolver resolver(io);
-      boost::asio::ip::udp::resolver::query query(
-          boost::asio::ip::udp::v4(), host, std::to_string(static_cast<std::uint32_t>(port)));
-      return *resolver.resolve(query);
+    template <async_recv_fn_like Callback_T>
+    struct dispatch_state {
+      dispatch_state(worker_pool& pool, Callback_T cb) : strands{pool}, callback{std::move(cb)} {}
+
+      detail::sender_strands strands;
+      Callback_T callback;
+      endpoint_type sender{};
+    };
+
+    // Everything in here is only touched on the strand, which all the ring's completions are run on.
+    template <async_recv_fn_like Callback_T>
+    struct ring_state {
+      ring_state(boost::asio::io_context& io, receive_ring_options opts, Callback_T cb)
+          : strand{boost::asio::make_strand(io)}, slots{opts}, callback{std::move(cb)}, posted{slots.depth()} {}
+
+      boost::asio::strand<boost::asio::io_context::executor_type> strand;
+      detail::receive_ring_slots slots;
+      Callback_T callback;
+      std::size_t posted;  // The receives that are waiting on the socket.
+    };
+
+    [[nodiscard]] bool _start_async_read() {
+      if (_in_kernel->sync_read_in_progress.load()) {
+        return false;
+      }
+
+      auto _                          = std::unique_lock{_in_kernel->mtx};
+      _in_kernel->stopping_async_read = false;
+      _in_kernel->async_read_stopped  = false;
+
+      _in_kernel->async_read_in_progress = true;
+      return true;
+    }
+
+    // Starts the next receive, unless the read is being cancelled. This is done under the lock, so that a cancel either sees
+    // the new receive (and cancels it) or is seen here.
+    template <typename Receive_T>
+    void _continue_async_read(Receive_T&& receive) {
+      _continue_async_read(std::forward<Receive_T>(receive), [this]() { _stop_async_read(); });
+    }
+
+    template <typename Receive_T, typename Stop_T>
+    void _continue_async_read(Receive_T&& receive, Stop_T&& stop) {
+      {
+        auto _ = std::unique_lock{_in_kernel->mtx};
+        if (not _in_kernel->stopping_async_read) {
+          receive();
+          return;
+        }
+      }
+
+      stop();
+    }
+
+    void _stop_async_read() {
+      {
+        auto _                         = std::unique_lock{_in_kernel->mtx};
+        _in_kernel->async_read_stopped = true;
+      }
+
+      _in_kernel->exiting_async_read.notify_all();
+    }
+
+    template <async_recv_fn_like Callback_T>
+    void _do_receive(Callback_T&& callback) {
+      auto recv_buf = _in_kernel->recv_data.prepare(_in_kernel->recv_buf_size);
+
+      _in_kernel->socket->async_receive(
+          recv_buf,
+          boost::asio::bind_cancellation_slot(
+              _receive_cancel_slot(), [this, cb = std::forward<Callback_T>(callback)](auto&& err, auto&& n) mutable {
+                if (err) {
+                  _stop_async_read();
+                  return;
+                }
+
+                _continue_async_read(
+                    [this, next = _do_receive_and_handle_data(std::move(cb), n)]() mutable { _do_receive(std::move(next)); });
+              }));
     }
 
     template <async_recv_fn_like Callback_T>
     [[nodiscard]] Callback_T _do_receive_and_handle_data(Callback_T callback, size_t n) {
       _in_kernel->recv_data.commit(n);
+      if (_in_kernel->probe) {
+        if (n < probe_header_size) {
+          _in_kernel->recv_data.consume(n);
+          return callback;
+        }
+
+        _record_latency(static_cast<const char*>(_in_kernel->recv_data.data().data()));
+        _in_kernel->recv_data.consume(probe_header_size);
+        n -= probe_header_size;
+      }
+
+      if (_in_kernel->tap) {
+        _in_kernel->tap({static_cast<const char*>(_in_kernel->recv_data.data().data()), n});
+      }
 
       auto data_stream = std::istream{&_in_kernel->recv_data};
       callback(data_stream, n);
@@ -138,10 +468,340 @@ namespace detail {
       return callback;
     }
 
+    // The datagram is copied out of the receive buffer and the next receive is posted before the callback is handed to the
+    // worker pool, so the socket always has a receive waiting while the callbacks run.
+    template <async_recv_fn_like Callback_T>
+    void _do_dispatched_receive(std::shared_ptr<dispatch_state<Callback_T>> state) {
+      auto recv_buf = _in_kernel->recv_data.prepare(_in_kernel->recv_buf_size);
+
+      auto on_receive = [this, state](auto&& err, size_t n) {
+        if (err) {
+          _stop_async_read();
+          return;
+        }
+
+        _in_kernel->recv_data.commit(n);
+
+        auto stamp = std::optional<probe_stamp>{};
+        if (_in_kernel->probe) {
+          if (n < probe_header_size) {
+            _in_kernel->recv_data.consume(n);
+            _continue_async_read([this, state]() { _do_dispatched_receive(state); });
+            return;
+          }
+
+          stamp.emplace();
+          _in_kernel->recv_data.sgetn(stamp->data(), static_cast<std::streamsize>(probe_header_size));
+          n -= probe_header_size;
+        }
+
+        auto datagram = std::make_shared<std::vector<char>>(n);
+        _in_kernel->recv_data.sgetn(datagram->data(), static_cast<std::streamsize>(n));
+        if (_in_kernel->tap) {
+          _in_kernel->tap(*datagram);
+        }
+
+        const auto strand = state->strands[state->sender];
+
+        _continue_async_read([this, state]() { _do_dispatched_receive(state); });
+
+        boost::asio::post(strand, [state, datagram = std::move(datagram), stamp, probe = _in_kernel->probe]() {
+          if (const auto latency = stamp ? probe_latency(stamp->data()) : std::nullopt) {
+            probe->record(*latency);
+          }
+
+          auto data_stream = boost::iostreams::stream<boost::iostreams::array_source>{datagram->data(), datagram->size()};
+          state->callback(data_stream, datagram->size());
+        });
+      };
+
+      _in_kernel->socket->async_receive_from(
+          recv_buf, state->sender, boost::asio::bind_cancellation_slot(_receive_cancel_slot(), std::move(on_receive)));
+    }
+
+    template <async_recv_fn_like Callback_T>
+    void _do_ring_receive(std::shared_ptr<ring_state<Callback_T>> state, std::size_t slot) {
+      const auto slot_buf = state->slots.buffer(slot);
+      auto recv_buf       = boost::asio::buffer(slot_buf.data(), slot_buf.size());
+
+      auto on_receive = [this, state, slot](const boost::system::error_code& err, size_t n) {
+        --state->posted;
+
+        if (err) {
+          _fail_ring(err);
+        } else {
+          state->slots.fill(slot, n);
+          _deliver_ring(state);
+        }
+
+        // Nothing's re-posted once the read is stopping, so this is the last of the ring's receives finishing.
+        if (state->posted == 0) {
+          _stop_async_read();
+        }
+      };
+
+      // Each of the ring's receives has a cancellation slot of its own, since a slot only holds one operation at a time.
+      _in_kernel->socket->async_receive(
+          recv_buf,
+          boost::asio::bind_cancellation_slot(_receive_cancel_slot(slot),
+                                              boost::asio::bind_executor(state->strand, std::move(on_receive))));
+    }
+
+    // Receives can complete out of order when there's more than one thread running the io_context, so a datagram is held in
+    // its slot until everything that arrived before it has been delivered. A slot is re-posted as soon as it's delivered.
+    template <async_recv_fn_like Callback_T>
+    void _deliver_ring(const std::shared_ptr<ring_state<Callback_T>>& state) {
+      while (const auto filled = state->slots.next_filled()) {
+        const auto [slot, n] = *filled;
+        _handle_ring_datagram(*state, state->slots.buffer(slot).first(n));
+        state->slots.advance();
+
+        _continue_async_read(
+            [this, &state, slot = slot]() {
+              ++state->posted;
+              _do_ring_receive(state, slot);
+            },
+            []() {});
+      }
+    }
+
+    template <async_recv_fn_like Callback_T>
+    void _handle_ring_datagram(ring_state<Callback_T>& state, std::span<char> datagram) {
+      if (_in_kernel->probe) {
+        if (datagram.size() < probe_header_size) {
+          return;
+        }
+
+        _record_latency(datagram.data());
+        datagram = datagram.subspan(probe_header_size);
+      }
+
+      if (_in_kernel->tap) {
+        _in_kernel->tap(datagram);
+      }
+
+      auto data_stream = boost::iostreams::stream<boost::iostreams::array_source>{datagram.data(), datagram.size()};
+      state.callback(data_stream, datagram.size());
+    }
+
+    // An error on any of the receives stops the whole ring, since the datagrams after the one that failed can't be delivered
+    // in order. Whatever's already been received into the ring is dropped.
+    void _fail_ring(const boost::system::error_code& err) {
+      if (err == boost::asio::error::operation_aborted) {
+        return;
+      }
+
+      auto _ = std::unique_lock{_in_kernel->mtx};
+      if (not _in_kernel->stopping_async_read) {
+        _in_kernel->stopping_async_read = true;
+        _cancel_receives();
+      }
+    }
+
+    void _record_latency(const char* header) {
+      if (const auto latency = probe_latency(header)) {
+        _in_kernel->probe->record(*latency);
+      }
+    }
+
+    // Receives the datagram that's waiting, without blocking; ec is would_block if there isn't one after all. Returns nothing
+    // if the datagram was dropped, because it was too short to have a probe header.
+    [[nodiscard]] std::optional<std::size_t> _receive_one(char* s, std::size_t n, boost::system::error_code& ec) {
+      if (not _in_kernel->probe) {
+        return _receive_now(boost::asio::buffer(s, n), ec);
+      }
+
+      auto stamp       = probe_stamp{};
+      const auto bytes = _receive_now(std::array{boost::asio::buffer(stamp), boost::asio::buffer(s, n)}, ec);
+      if (ec) {
+        return 0;
+      }
+
+      if (bytes < probe_header_size) {
+        return std::nullopt;
+      }
+
+      _record_latency(stamp.data());
+      return bytes - probe_header_size;
+    }
+
+    // Asio's own receive waits for a datagram unless the socket has been put in non-blocking mode, and doing that would make
+    // the sends of a basic_sink that shares the socket fail rather than wait for room. So the receive is done directly.
+    template <typename Buffers_T>
+    [[nodiscard]] std::size_t _receive_now(const Buffers_T& buffers, boost::system::error_code& ec) {
+#if defined(_WIN32)
+      // Winsock has no per-call flag for this. poll() has said that a datagram is waiting, though, so this only waits if
+      // another reader of the socket takes it first.
+      return _in_kernel->socket->receive(buffers, 0, ec);
+#else
+      auto iov   = std::array<iovec, 2>{};
+      auto count = std::size_t{0};
+      for (auto it = boost::asio::buffer_sequence_begin(buffers); it != boost::asio::buffer_sequence_end(buffers); ++it) {
+        iov[count++] = iovec{it->data(), it->size()};
+      }
+
+      auto msg         = msghdr{};
+      msg.msg_iov      = iov.data();
+      msg.msg_iovlen   = static_cast<decltype(msg.msg_iovlen)>(count);
+      const auto bytes = ::recvmsg(_in_kernel->socket->native_handle(), &msg, MSG_DONTWAIT);
+      if (bytes < 0) {
+        ec = boost::system::error_code{errno, boost::asio::error::get_system_category()};
+        return 0;
+      }
+
+      ec = boost::system::error_code{};
+      return static_cast<std::size_t>(bytes);
+#endif
+    }
+
+    [[nodiscard]] recv_result _read_before(char* s,
+                                           std::size_t n,
+                                           std::chrono::steady_clock::time_point deadline,
+                                           recv_status on_timeout) {
+      if (_in_kernel->async_read_in_progress) {
+        return {recv_status::error, 0, boost::asio::error::already_started};
+      }
+
+      _in_kernel->sync_read_in_progress = true;
+      auto _                            = wite::scope_exit{[this]() { _in_kernel->sync_read_in_progress = false; }};
+
+      while (true) {
+        auto ec = boost::system::error_code{};
+        if (not _wait_readable(deadline, ec)) {
+          return ec ? recv_result{recv_status::error, 0, ec} : recv_result{on_timeout};
+        }
+
+        // If the datagram's gone by the time it's asked for, this goes back to waiting for whatever time is left.
+        const auto bytes_recvd = _receive_one(s, n, ec);
+        if (ec == boost::asio::error::would_block) {
+          continue;
+        }
+
+        if (ec) {
+          return {recv_status::error, 0, ec};
+        }
+
+        if (bytes_recvd) {
+          if (_in_kernel->tap) {
+            _in_kernel->tap({s, *bytes_recvd});
+          }
+
+          return {recv_status::ok, *bytes_recvd};
+        }
+      }
+    }
+
+    // Waits, until the deadline at the latest, for the socket to have something to read. A wait that can block waits on a
+    // wakeup channel too, so that cancel_sync_read() can stop the wait without having to cancel the socket; that sets ec to
+    // operation_aborted. A wait that can't block (try_read's) returns straight away anyway, so it doesn't open one.
+    [[nodiscard]] bool _wait_readable(std::chrono::steady_clock::time_point deadline, boost::system::error_code& ec) {
+      const auto can_block = deadline > std::chrono::steady_clock::now();
+      const auto wakeup    = can_block ? _open_wakeup() : wakeup_channel::native_handle_type{};
+      auto _               = wite::scope_exit{[this, can_block]() {
+        if (can_block) {
+          _close_wakeup();
+        }
+      }};
+      const auto fd_count = can_block ? 2 : 1;
+
+      while (true) {
+        if (_in_kernel->sync_read_cancelled) {
+          ec = boost::asio::error::operation_aborted;
+          return false;
+        }
+
+        auto timeout_ms = -1;
+        if (deadline != std::chrono::steady_clock::time_point::max()) {
+          const auto remaining = std::max(deadline - std::chrono::steady_clock::now(), std::chrono::steady_clock::duration{0});
+          timeout_ms           = static_cast<int>(std::min<std::chrono::milliseconds::rep>(
+              std::chrono::ceil<std::chrono::milliseconds>(remaining).count(), std::numeric_limits<int>::max()));
+        }
+
+#if defined(_WIN32)
+        auto fds         = std::array{WSAPOLLFD{_in_kernel->socket->native_handle(), POLLRDNORM, 0},
+                              WSAPOLLFD{wakeup, POLLRDNORM, 0}};
+        const auto ready = ::WSAPoll(fds.data(), static_cast<ULONG>(fd_count), timeout_ms);
+        if (ready < 0) {
+          ec = boost::system::error_code{::WSAGetLastError(), boost::asio::error::get_system_category()};
+          return false;
+        }
+#else
+        auto fds         = std::array{pollfd{_in_kernel->socket->native_handle(), POLLIN, 0}, pollfd{wakeup, POLLIN, 0}};
+        const auto ready = ::poll(fds.data(), static_cast<nfds_t>(fd_count), timeout_ms);
+        if (ready < 0) {
+          if (errno == EINTR) {
+            continue;
+          }
+
+          ec = boost::system::error_code{errno, boost::asio::error::get_system_category()};
+          return false;
+        }
+#endif
+
+        // The channel is new for each wait, so a poke can only have come from a cancel of this one; that's seen at the top of
+        // the loop.
+        if (fds[1].revents != 0) {
+          _clear_wakeups();
+          continue;
+        }
+
+        if (fds[0].revents != 0) {
+          return true;
+        }
+
+        if (std::chrono::steady_clock::now() >= deadline) {
+          return false;
+        }
+      }
+    }
+
+    [[nodiscard]] wakeup_channel::native_handle_type _open_wakeup() {
+      auto _ = std::unique_lock{_in_kernel->mtx};
+      return _in_kernel->wakeup.emplace(_in_kernel->io).native_handle();
+    }
+
+    void _close_wakeup() {
+      auto _ = std::unique_lock{_in_kernel->mtx};
+      _in_kernel->wakeup.reset();
+    }
+
+    // If the blocking read has already stopped waiting, there's nothing to wake; it sees that it's been cancelled before it
+    // next waits.
+    void _wake_sync_read() {
+      auto _ = std::unique_lock{_in_kernel->mtx};
+      if (_in_kernel->wakeup) {
+        _in_kernel->wakeup->poke();
+      }
+    }
+
+    void _clear_wakeups() {
+      auto _ = std::unique_lock{_in_kernel->mtx};
+      _in_kernel->wakeup->drain();
+    }
+
+    // The slot that the index'th of the receives that can be waiting at once is bound to. Must be called with mtx held.
+    [[nodiscard]] boost::asio::cancellation_slot _receive_cancel_slot(std::size_t index = 0) {
+      auto& signals = _in_kernel->receive_cancels;
+      while (signals.size() <= index) {
+        signals.push_back(std::make_unique<boost::asio::cancellation_signal>());
+      }
+
+      return signals[index]->slot();
+    }
+
+    // Cancels just the receives, and not the sends of a basic_sink that shares the socket, which socket->cancel() would.
+    // Must be called with mtx held.
+    void _cancel_receives() {
+      for (auto& signal : _in_kernel->receive_cancels) {
+        signal->emit(boost::asio::cancellation_type::terminal);
+      }
+    }
+
     void _do_cancel_async_read() {
-      auto lock = std::unique_lock{_in_kernel->mtx};
-      _in_kernel->socket.cancel();
-      _in_kernel->exiting_async_read.wait(lock);
+      auto lock                       = std::unique_lock{_in_kernel->mtx};
+      _in_kernel->stopping_async_read = true;
+      _cancel_receives();
+      _in_kernel->exiting_async_read.wait(lock, [this]() { return _in_kernel->async_read_stopped; });
 
       // The last point that we have visibility on the process is marked by the condition variable, however
       // there is still stuff to happen after that point, so we wait for a bit.
@@ -151,60 +811,32 @@ namespace detail {
       _in_kernel->async_read_in_progress = false;
     }
 
+    // A blocking read is woken from its wait, and gives up because it's been cancelled. This doesn't touch the socket, so the
+    // sends of a basic_sink that shares it carry on.
     void _do_cancel_sync_read() {
-      auto lock = std::unique_lock{_in_kernel->mtx};
-      _in_kernel->socket.cancel();
-
-      std::this_thread::sleep_for(std::chrono::milliseconds{2});
-
-      _in_kernel->sync_read_in_progress = false;
+      _in_kernel->sync_read_cancelled = true;
+      _wake_sync_read();
+      while (_in_kernel->sync_read_in_progress.load()) {
+        std::this_thread::yield();
+      }
+      _in_kernel->sync_read_cancelled = false;
     }
 
     std::shared_ptr<kernel> _in_kernel;
   };
+
+  using source = basic_source<boost::asio::ip::udp>;
 }  // namespace detail
 
 using istreambuf = boost::iostreams::stream_buffer<detail::source>;
-class istream : public boost::iostreams::stream<detail::source> {
+class istream : public boost::iostreams::stream<detail::source>, public datagram_istream<istream> {
  public:
-  explicit istream(boost::asio::io_context& io, port_number port) : boost::iostreams::stream<detail::source>{io, port} {}
-
-  void cancel_async_recv() {
-    (*this)->cancel_async_read();
+  explicit istream(boost::asio::io_context& io, port_number port)
+      : boost::iostreams::stream<detail::source>{detail::source{io, detail::resolve_endpoint(io, "0.0.0.0", port)}} {}
 
-    // Clear any error that previously occurred on the stream, since someone may have tried to synchronously read the stream
-    // while the async read was in progress. This will have put the stream in an error state and it will not be possible to
-    // read from the stream until that error is cleared.
-    clear();
-  }
-
-  void cancel_sync_recv() {
-    (*this)->cancel_sync_read();
+  explicit istream(boost::asio::io_context& io, std::shared_ptr<boost::asio::ip::udp::socket> socket)
+      : boost::iostreams::stream<detail::source>{detail::source{io, std::move(socket)}} {}
 
-    // Clear any error that previously occurred on the stream, since someone may have tried to synchronously read the stream
-    // while the async read was in progress. This will have put the stream in an error state and it will not be possible to
-    // read from the stream until that error is cleared.
-    clear();
-  }
 };
 
-template <contiguous_byte_range_like Range_T>
-  requires(not std::is_same_v<std::string, std::decay_t<Range_T>>)
-istream& operator>>(istream& is, Range_T&& bytes) {
-  if (not bytes.empty()) {
-    is.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
-  }
-
-  return is;
-}
-
-template <async_recv_fn_like Callback_T>
-istream& operator>>(istream& is, Callback_T&& callback) {
-  if (not is->async_read(std::forward<Callback_T>(callback))) {
-    is.setstate(std::ios::failbit);
-  }
-
-  return is;
-}
-
 }  // namespace nsl::udp
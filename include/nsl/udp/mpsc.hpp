@@ -0,0 +1,228 @@
+#pragma once
+
+#include "ostream.hpp"
+#include "resolve.hpp"
+#include "types.hpp"
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/iostreams/stream.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace nsl::udp {
+
+struct mpsc_options {
+  std::size_t send_batch = 64;  // The most datagrams handed to the kernel in one go.
+};
+
+namespace detail {
+
+  struct queued_datagram {
+    std::atomic<queued_datagram*> next{nullptr};
+    std::vector<char> data;
+  };
+
+  // Dmitry Vyukov's intrusive multi-producer, single-consumer queue. Pushing is one atomic exchange, and never waits for
+  // anything. A pop can come back empty while a push is half done, even though the queue isn't empty; drained() says whether
+  // that's happened.
+  class mpsc_queue {
+   public:
+    mpsc_queue() = default;
+
+    mpsc_queue(const mpsc_queue&)            = delete;
+    mpsc_queue& operator=(const mpsc_queue&) = delete;
+
+    ~mpsc_queue() {
+      while (auto* datagram = pop()) {
+        delete datagram;
+      }
+    }
+
+    // Safe to call from any thread.
+    void push(queued_datagram* datagram) noexcept {
+      datagram->next.store(nullptr, std::memory_order_relaxed);
+      auto* prev = _head.exchange(datagram);
+      prev->next.store(datagram, std::memory_order_release);
+    }
+
+    // Whether anything's been pushed since the queue was last empty. Safe to call from any thread, since it only looks at the
+    // head, but it can't see datagrams that a pop() left behind when it ran into a push that was half done.
+    [[nodiscard]] bool empty() const noexcept { return _head.load() == &_stub; }
+
+    // Whether everything that's been pushed, as far as the consumer can see, has been popped. Only called by the consumer.
+    [[nodiscard]] bool drained() const noexcept {
+      return _tail == &_stub and _stub.next.load(std::memory_order_acquire) == nullptr;
+    }
+
+    // Only ever called from one thread at a time.
+    [[nodiscard]] queued_datagram* pop() noexcept {
+      auto* tail = _tail;
+      auto* next = tail->next.load(std::memory_order_acquire);
+
+      if (tail == &_stub) {
+        if (next == nullptr) {
+          return nullptr;
+        }
+
+        _tail = next;
+        tail  = next;
+        next  = next->next.load(std::memory_order_acquire);
+      }
+
+      if (next != nullptr) {
+        _tail = next;
+        return tail;
+      }
+
+      if (tail != _head.load(std::memory_order_acquire)) {
+        return nullptr;
+      }
+
+      push(&_stub);
+
+      next = tail->next.load(std::memory_order_acquire);
+      if (next != nullptr) {
+        _tail = next;
+        return tail;
+      }
+
+      return nullptr;
+    }
+
+   private:
+    queued_datagram _stub{};
+    std::atomic<queued_datagram*> _head{&_stub};
+    queued_datagram* _tail{&_stub};
+  };
+
+  // The queue is drained through a sink, and so onto its socket, with its probe, sequencing and coalescing.
+  struct mpsc_kernel {
+    mpsc_kernel(boost::asio::io_context& io, sink out, mpsc_options opts)
+        : io{io}, out{std::move(out)}, opts{std::max(opts.send_batch, std::size_t{1})} {}
+
+    boost::asio::io_context& io;
+    sink out;
+    mpsc_options opts;
+
+    mpsc_queue queue{};
+    std::atomic_bool drain_scheduled{false};
+    std::atomic<std::uint64_t> failed_sends{0};
+
+    // Only touched by the drain, which is never running on more than one thread at once.
+    std::vector<std::unique_ptr<queued_datagram>> batch{};
+    std::vector<std::span<const char>> batch_data{};
+  };
+
+  inline void mpsc_send_batch(mpsc_kernel& k) {
+    k.batch_data.clear();
+    for (const auto& datagram : k.batch) {
+      k.batch_data.emplace_back(datagram->data.data(), datagram->data.size());
+    }
+
+    k.failed_sends += k.out.send_batch(k.batch_data);
+    k.batch.clear();
+  }
+
+  // Sends everything that's in the queue. Only one drain is ever posted or running at once: drain_scheduled is set by
+  // whoever posts it, and isn't cleared until this one has finished with the queue.
+  inline void mpsc_drain(const std::shared_ptr<mpsc_kernel>& k) {
+    for (auto* datagram = k->queue.pop(); datagram != nullptr; datagram = k->queue.pop()) {
+      k->batch.emplace_back(datagram);
+      if (k->batch.size() == k->opts.send_batch) {
+        mpsc_send_batch(*k);
+      }
+    }
+
+    mpsc_send_batch(*k);
+
+    // A pop that ran into a half-done push leaves datagrams behind, and the producer may already have seen that a drain is
+    // scheduled, so this one carries on until they've gone. It's posted rather than run here, so that the producer doesn't
+    // hold up the io thread while it finishes its push.
+    if (not k->queue.drained()) {
+      boost::asio::post(k->io, [k]() { mpsc_drain(k); });
+      return;
+    }
+
+    // Anything pushed after the last pop, by a producer that found the drain still scheduled, is picked up by another drain.
+    k->drain_scheduled.store(false);
+    if (not k->queue.empty() and not k->drain_scheduled.exchange(true)) {
+      boost::asio::post(k->io, [k]() { mpsc_drain(k); });
+    }
+  }
+
+  // The first producer to find that there's no drain on the way posts one; everyone else just pushes.
+  inline void mpsc_push(const std::shared_ptr<mpsc_kernel>& k, const char* s, std::size_t n) {
+    auto datagram = std::make_unique<queued_datagram>();
+    datagram->data.assign(s, s + n);
+    k->queue.push(datagram.release());
+
+    if (not k->drain_scheduled.exchange(true)) {
+      boost::asio::post(k->io, [k]() { mpsc_drain(k); });
+    }
+  }
+
+  // Each producer_ostream has one of these, so the formatting happens in the producer's own buffer, and only the finished
+  // datagram is shared.
+  class producer_sink {
+   public:
+    using char_type = char;
+    using category  = boost::iostreams::sink_tag;
+
+    explicit producer_sink(std::shared_ptr<mpsc_kernel> k) : _kernel{std::move(k)} {}
+
+    [[nodiscard]] std::streamsize write(const char* s, std::streamsize n) {
+      mpsc_push(_kernel, s, static_cast<std::size_t>(n));
+      return n;
+    }
+
+   private:
+    std::shared_ptr<mpsc_kernel> _kernel;
+  };
+
+}  // namespace detail
+
+// One thread's way in to an mpsc_sender. Each flush sends what's been written since the last one as a datagram. A
+// producer_ostream is for one thread to use; make one for each thread that sends.
+class producer_ostream : public boost::iostreams::stream<detail::producer_sink>, public datagram_ostream<producer_ostream> {
+ public:
+  explicit producer_ostream(std::shared_ptr<detail::mpsc_kernel> k)
+      : boost::iostreams::stream<detail::producer_sink>{detail::producer_sink{std::move(k)}} {}
+};
+
+// Lets any number of threads send from one socket without taking a lock. Datagrams are pushed onto a lock-free queue, and
+// sent in batches on the io_context, so that has to be running. Each producer's datagrams are sent in the order that it
+// sent them.
+class mpsc_sender {
+ public:
+  explicit mpsc_sender(boost::asio::io_context& io, std::string host, port_number port, mpsc_options opts = mpsc_options{})
+      : _kernel{std::make_shared<detail::mpsc_kernel>(
+            io, detail::sink{io, detail::resolve_endpoint(io, std::move(host), port)}, opts)} {}
+
+  // Sends through out's sink: from its socket, to its destination, and with its probe, sequencing and coalescing, if they're
+  // on. Turn those on before anything is sent.
+  explicit mpsc_sender(boost::asio::io_context& io, ostream& out, mpsc_options opts = mpsc_options{})
+      : _kernel{std::make_shared<detail::mpsc_kernel>(io, *out, opts)} {}
+
+  [[nodiscard]] producer_ostream make_producer() const { return producer_ostream{_kernel}; }
+
+  // Sends the bytes as one datagram. Safe to call from any thread.
+  void send(std::span<const char> datagram) { detail::mpsc_push(_kernel, datagram.data(), datagram.size()); }
+
+  [[nodiscard]] std::uint64_t failed_sends() const noexcept { return _kernel->failed_sends.load(); }
+
+ private:
+  std::shared_ptr<detail::mpsc_kernel> _kernel;
+};
+
+}  // namespace nsl::udp
@@ -1,20 +1,47 @@
 #pragma once
 
+#include "coalesce.hpp"
+#include "probe.hpp"
+#include "resolve.hpp"
+#include "sequenced.hpp"
 #include "types.hpp"
 
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/ip/udp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/endian/conversion.hpp>
 #include <boost/iostreams/device/array.hpp>
 #include <boost/iostreams/device/back_inserter.hpp>
 #include <boost/iostreams/stream.hpp>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
 #include <istream>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <span>
+#include <stdexcept>
 #include <string>
 #include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <cerrno>
+#endif
 
 namespace boost::asio {
 class io_context;
@@ -22,82 +49,625 @@ class io_context;
 
 namespace nsl::udp {
 
+// What async_write should do when the send queue is already at its high-water mark.
+enum class overflow_policy {
+  fail,        // Reject the new datagram (the stream's failbit is set).
+  block,       // Wait for space. Don't use this from the io thread, since that's what makes the space.
+  drop_oldest  // Drop the oldest datagram that isn't already being sent; its callback gets operation_aborted.
+};
+
+struct send_queue_options {
+  std::size_t high_water_mark  = 1024;
+  overflow_policy on_overflow  = overflow_policy::fail;
+  std::size_t completion_batch = 16;
+};
+
+template <contiguous_byte_range_like... Ranges_T>
+[[nodiscard]] gathered_datagram<sizeof...(Ranges_T)> gather(const Ranges_T&... pieces) {
+  return {{detail::as_chars(pieces)...}};
+}
+
 namespace detail {
 
-  class sink {
-    struct kernel {
-      kernel(boost::asio::io_context& io, std::string host, port_number port)
-          : io{io}, socket{io, boost::asio::ip::udp::endpoint(boost::asio::ip::udp::v4(), 0)}, endpoint{} {
-        endpoint = sink::_resolve_endpoint(io, std::move(host), port);
-      }
+  // Whatever the probe and sequencing put in front of a datagram's data, and its frame length if it's a datagram that's been
+  // framed on its own because coalescing is on.
+  struct datagram_header {
+    std::array<char, probe_header_size + sequence_header_size + frame_header_size> bytes{};
+    std::size_t size{0};
+  };
 
-      ~kernel() {
-        if (socket.is_open()) {
-          socket.close();
-        }
-      }
+  // The sending end of a datagram socket; see basic_source.
+  template <typename Protocol_T>
+  class basic_sink {
+    using endpoint_type = typename Protocol_T::endpoint;
+    using socket_type   = typename Protocol_T::socket;
+
+    // Asio hands at most this many buffers to the socket in one send, and quietly leaves the rest out of the datagram.
+    static constexpr auto max_gather_buffers = std::size_t{64};
+
+    using send_callback = std::function<void(const boost::system::error_code&, size_t)>;
 
+    struct pending_send {
+      std::shared_ptr<const void> data;
+      boost::asio::const_buffer buffer;
+      send_callback callback;
+      datagram_header header{};
+    };
+
+    struct completed_send {
+      send_callback callback;
+      boost::system::error_code ec;
+      size_t n;
+    };
+
+    struct kernel {
+      kernel(boost::asio::io_context& io,
+             std::shared_ptr<socket_type> socket,
+             endpoint_type endpoint,
+             send_queue_options opts)
+          : io{io}
+          , socket{std::move(socket)}
+          , endpoint{std::move(endpoint)}
+          , send_opts{std::max(opts.high_water_mark, std::size_t{1}), opts.on_overflow, opts.completion_batch} {}
+
+      // The socket is closed by whichever of this and a basic_source that shares it goes last, so this can carry on sending
+      // after the source has gone.
       boost::asio::io_context& io;
-      boost::asio::ip::udp::socket socket;
-      boost::asio::ip::udp::endpoint endpoint;
+      std::shared_ptr<socket_type> socket;
+      endpoint_type endpoint;
+
+      // The front of the send queue is the datagram that's currently being sent, if send_in_progress is set.
+      send_queue_options send_opts;
+      std::mutex send_mtx;
+      std::condition_variable send_space_available;
+      std::deque<pending_send> send_queue;
+      bool send_in_progress{false};
+      std::vector<completed_send> completed_sends;
+
+      // The buffer that prepare() hands out, and how much of it was asked for.
+      std::vector<char> datagram_buf{};
+      std::size_t prepared{0};
+
+      // The list of pieces that send_gathered() hands to the socket, which is reused from one datagram to the next, and the
+      // buffer that the pieces are copied into when there are too many of them to hand over as a list.
+      std::vector<boost::asio::const_buffer> gather_bufs{};
+      std::vector<char> gather_joined{};
+
+      // Only touched by send_batch(), which is never running on more than one thread at once.
+      std::vector<datagram_header> batch_headers{};
+#if defined(__linux__)
+      std::vector<std::array<iovec, 2>> batch_iovecs{};
+      std::vector<mmsghdr> batch_messages{};
+#endif
+
+      // If the latency probe or sequencing are on, every datagram is sent with a header in front of it.
+      std::optional<probe_stamper> probe{};
+      bool sequenced{false};
+      std::atomic<std::uint64_t> next_sequence{0};
+      datagram_header in_flight_header{};
+
+      // If coalescing is on, messages are packed into the pending datagram, which is sent when it's full or when the timer
+      // goes off. The timer is only touched under coalesce_mtx, and is only armed when it isn't already.
+      std::mutex coalesce_mtx;
+      std::optional<coalescer> pending{};
+      std::optional<boost::asio::steady_timer> coalesce_timer{};
+      bool coalesce_timer_armed{false};
     };
 
    public:
     using char_type = char;
     using category  = boost::iostreams::sink_tag;
 
-    explicit sink(boost::asio::io_context& io, std::string host, std::uint16_t port)
-        : _out_kernel{std::make_shared<kernel>(io, std::move(host), port)} {}
+    explicit basic_sink(boost::asio::io_context& io,
+                        endpoint_type endpoint,
+                        send_queue_options send_opts = send_queue_options{})
+        : basic_sink{io, _open(io), std::move(endpoint), send_opts} {}
+
+    // Sends from a socket that's shared with a basic_source, so that replies come back to the address it's bound to.
+    explicit basic_sink(boost::asio::io_context& io,
+                        std::shared_ptr<socket_type> socket,
+                        endpoint_type endpoint,
+                        send_queue_options send_opts = send_queue_options{})
+        : _out_kernel{std::make_shared<kernel>(io, std::move(socket), std::move(endpoint), send_opts)} {}
 
-    sink()                       = delete;
-    sink(const sink&)            = default;
-    sink& operator=(const sink&) = delete;
-    sink(sink&&)                 = default;
-    sink& operator=(sink&&)      = default;
+    basic_sink()                             = delete;
+    basic_sink(const basic_sink&)            = default;
+    basic_sink& operator=(const basic_sink&) = delete;
+    basic_sink(basic_sink&&)                 = default;
+    basic_sink& operator=(basic_sink&&)      = default;
 
-    ~sink() {}
+    ~basic_sink() {}
 
     [[nodiscard]] std::streamsize write(const char* s, std::streamsize n) {
-      return _out_kernel->socket.send_to(boost::asio::buffer(s, n), _out_kernel->endpoint);
+      if (_out_kernel->pending) {
+        _coalesce(_out_kernel, s, static_cast<std::size_t>(n));
+        return n;
+      }
+
+      return static_cast<std::streamsize>(_send(*_out_kernel, s, static_cast<std::size_t>(n)));
     }
 
-    template <typename Data_T, async_send_fn_like Callback_T>
-    void async_write([[maybe_unused]] std::pair<Data_T, Callback_T>&& data_and_callback) {
+    // Returns a buffer of n bytes that the next datagram can be built in, in place. The buffer is reused, so it's only valid
+    // until the next call to prepare() or commit().
+    [[nodiscard]] std::span<char> prepare(std::size_t n) {
+      auto& buf = _out_kernel->datagram_buf;
+      if (buf.size() < n) {
+        buf.resize(n);
+      }
+
+      _out_kernel->prepared = n;
+      return {buf.data(), n};
+    }
+
+    // Sends the first n bytes of the prepared buffer as exactly one datagram.
+    std::size_t commit(std::size_t n) {
+      if (n > std::exchange(_out_kernel->prepared, 0)) {
+        throw std::length_error{"committed more data than was prepared"};
+      }
+
+      flush_coalesced();
+      return _send(*_out_kernel, _out_kernel->datagram_buf.data(), n, _solo_frame(*_out_kernel, n));
+    }
+
+    // Sends the pieces, in order, as one datagram. They're handed to the socket as a list, so they aren't copied into a
+    // single buffer first, unless there are more of them than the socket will take in one go. Like write() and commit(),
+    // this sends straight away, so it can overtake datagrams that are still in the async send queue.
+    template <byte_range_sequence_like Pieces_T>
+    std::size_t send_gathered(const Pieces_T& pieces) {
+      auto ec         = boost::system::error_code{};
+      const auto sent = send_gathered(pieces, ec);
+      if (ec) {
+        throw boost::system::system_error{ec};
+      }
+
+      return sent;
+    }
+
+    template <byte_range_sequence_like Pieces_T>
+    std::size_t send_gathered(const Pieces_T& pieces, boost::system::error_code& ec) {
+      if (_out_kernel->pending) {
+        auto _ = std::unique_lock{_out_kernel->coalesce_mtx};
+        _send_pending(*_out_kernel, ec);
+        if (ec) {
+          return 0;
+        }
+      }
 
-      // _out_kernel->socket.set_option(boost::asio::socket_base::send_buffer_size{static_cast<int>(data_and_callback.first.size())});
+      auto total       = std::size_t{0};
+      auto piece_count = std::size_t{0};
+      for (const auto& piece : pieces) {
+        total += as_chars(piece).size();
+        ++piece_count;
+      }
+
+      auto& bufs = _out_kernel->gather_bufs;
+      bufs.clear();
+
+      const auto header = _make_header(*_out_kernel, _solo_frame(*_out_kernel, total));
+      if (header.size > 0) {
+        bufs.emplace_back(header.bytes.data(), header.size);
+      }
+
+      if (bufs.size() + piece_count <= max_gather_buffers) {
+        for (const auto& piece : pieces) {
+          const auto chars = as_chars(piece);
+          bufs.emplace_back(chars.data(), chars.size());
+        }
+      } else {
+        auto& joined = _out_kernel->gather_joined;
+        joined.clear();
+        for (const auto& piece : pieces) {
+          const auto chars = as_chars(piece);
+          joined.insert(joined.end(), chars.begin(), chars.end());
+        }
+
+        bufs.emplace_back(joined.data(), joined.size());
+      }
+
+      const auto sent = _out_kernel->socket->send_to(bufs, _out_kernel->endpoint, 0, ec);
+      return sent < header.size ? 0 : sent - header.size;
+    }
+
+    // Sends each of the datagrams straight away, with whatever header the probe and sequencing put on it, in as few calls as
+    // it takes (sendmmsg ones, on Linux). With coalescing on, they're coalesced like anything else that's written. Returns
+    // how many of them couldn't be sent. Only call this from one thread at a time.
+    std::size_t send_batch(std::span<const std::span<const char>> datagrams) {
+      auto& k     = *_out_kernel;
+      auto failed = std::size_t{0};
+
+      if (k.pending) {
+        for (const auto datagram : datagrams) {
+          try {
+            _coalesce(_out_kernel, datagram.data(), datagram.size());
+          } catch (const std::exception&) {
+            ++failed;
+          }
+        }
+
+        return failed;
+      }
+
+      k.batch_headers.resize(datagrams.size());
+      for (auto& header : k.batch_headers) {
+        header = _make_header(k);
+      }
+
+#if defined(__linux__)
+      k.batch_iovecs.resize(datagrams.size());
+      k.batch_messages.resize(datagrams.size());
+
+      for (auto i = std::size_t{0}; i < datagrams.size(); ++i) {
+        k.batch_iovecs[i] = {iovec{k.batch_headers[i].bytes.data(), k.batch_headers[i].size},
+                             iovec{const_cast<char*>(datagrams[i].data()), datagrams[i].size()}};
+
+        k.batch_messages[i]                     = mmsghdr{};
+        k.batch_messages[i].msg_hdr.msg_name    = k.endpoint.data();
+        k.batch_messages[i].msg_hdr.msg_namelen = static_cast<socklen_t>(k.endpoint.size());
+        k.batch_messages[i].msg_hdr.msg_iov     = k.batch_iovecs[i].data();
+        k.batch_messages[i].msg_hdr.msg_iovlen  = k.batch_iovecs[i].size();
+      }
+
+      const auto fd = k.socket->native_handle();
+      for (auto sent = std::size_t{0}; sent < datagrams.size();) {
+        const auto result =
+            ::sendmmsg(fd, k.batch_messages.data() + sent, static_cast<unsigned int>(datagrams.size() - sent), 0);
+        if (result < 0) {
+          if (errno == EINTR) {
+            continue;
+          }
 
-      auto data_to_send = std::make_shared<Data_T>(std::move(data_and_callback.first));
+          // sendmmsg only fails outright if the first message couldn't be sent, so skip over that one and carry on.
+          ++failed;
+          ++sent;
+          continue;
+        }
+
+        sent += static_cast<std::size_t>(result);
+      }
+#else
+      for (auto i = std::size_t{0}; i < datagrams.size(); ++i) {
+        const auto& header = k.batch_headers[i];
+        const auto buffers = std::array{boost::asio::buffer(header.bytes.data(), header.size),
+                                        boost::asio::buffer(datagrams[i].data(), datagrams[i].size())};
+
+        auto ec = boost::system::error_code{};
+        k.socket->send_to(buffers, k.endpoint, 0, ec);
+        if (ec) {
+          ++failed;
+        }
+      }
+#endif
+
+      return failed;
+    }
+
+    // Queues the data to be sent as a single datagram. Datagrams are sent one at a time, in the order that they were queued,
+    // and their callbacks are run in batches of up to send_queue_options::completion_batch. Returns false if the datagram was
+    // rejected because the queue was full.
+    template <typename Data_T, async_send_fn_like Callback_T>
+    [[nodiscard]] bool async_write(std::pair<Data_T, Callback_T>&& data_and_callback) {
+      // Messages that were written earlier, and are still waiting to be coalesced, go first.
+      flush_coalesced();
+
+      auto data_to_send = std::make_shared<const Data_T>(std::move(data_and_callback.first));
       auto send_buf     = boost::asio::buffer(*data_to_send);
-      _out_kernel->socket.async_send_to(
-          send_buf,
-          _out_kernel->endpoint,
-          [data = std::move(data_to_send), callback = std::move(data_and_callback.second)](auto&& ec, size_t n) {
-            if (not ec) {
-              callback(n);
+      const auto frame  = _solo_frame(*_out_kernel, send_buf.size());
+
+      auto to_send       = pending_send{std::move(data_to_send), send_buf, _make_send_callback(std::move(data_and_callback.second))};
+      auto dropped       = std::optional<pending_send>{};
+      auto start_sending = false;
+
+      {
+        auto lock   = std::unique_lock{_out_kernel->send_mtx};
+        auto& queue = _out_kernel->send_queue;
+
+        if (queue.size() >= _out_kernel->send_opts.high_water_mark) {
+          switch (_out_kernel->send_opts.on_overflow) {
+            case overflow_policy::fail:
+              return false;
+            case overflow_policy::block:
+              _out_kernel->send_space_available.wait(
+                  lock, [&]() { return queue.size() < _out_kernel->send_opts.high_water_mark; });
+              break;
+            case overflow_policy::drop_oldest: {
+              const auto oldest = queue.begin() + (_out_kernel->send_in_progress ? 1 : 0);
+              if (oldest == queue.end()) {
+                return false;
+              }
+
+              dropped = std::move(*oldest);
+              queue.erase(oldest);
+              break;
             }
-          });
+          }
+        }
+
+        // The header is made under the lock, so that sequence numbers go out in order.
+        to_send.header = _make_header(*_out_kernel, frame);
+        queue.push_back(std::move(to_send));
+        start_sending = not std::exchange(_out_kernel->send_in_progress, true);
+      }
+
+      if (dropped) {
+        dropped->callback(boost::asio::error::operation_aborted, 0);
+      }
+
+      if (start_sending) {
+        _send_front(_out_kernel);
+      }
+
+      return true;
+    }
+
+    [[nodiscard]] size_t queued_sends() const {
+      auto _ = std::unique_lock{_out_kernel->send_mtx};
+      return _out_kernel->send_queue.size();
+    }
+
+    // Prefixes every datagram from now on with a probe header, for an istream with the probe enabled to measure. Turn this
+    // on before anything is written.
+    void enable_latency_probe(probe_options opts = probe_options{}) { _out_kernel->probe.emplace(opts); }
+
+    // Numbers every datagram from now on, for a receiver using udp::sequenced() to put back in order. Turn this on before
+    // anything is written.
+    void enable_sequencing() { _out_kernel->sequenced = true; }
+
+    // Packs everything that's written from now on into length-prefixed messages, several to a datagram, for a receiver using
+    // udp::deframed() to split up again. The flush timer runs on the io_context, so that has to be running. Turn this on
+    // before anything is written.
+    void enable_coalescing(coalesce_options opts = coalesce_options{}) {
+      _out_kernel->pending.emplace(opts);
+      _out_kernel->coalesce_timer.emplace(_out_kernel->io);
+    }
+
+    // Sends the messages that are waiting to be coalesced now, rather than when the datagram fills up or the timer goes off.
+    void flush_coalesced() {
+      if (not _out_kernel->pending) {
+        return;
+      }
+
+      auto _ = std::unique_lock{_out_kernel->coalesce_mtx};
+      _send_pending_or_throw(*_out_kernel);
     }
 
    private:
-    friend struct kernel;
-    [[nodiscard]] static boost::asio::ip::udp::endpoint _resolve_endpoint(boost::asio::io_context& io,
-                                                                          std::string host,
-                                                                          port_number port) {
-      boost::asio::ip::udp::resolver resolver(io);
-      boost::asio::ip::udp::resolver::query query(
-          boost::asio::ip::udp::v4(), host, std::to_string(static_cast<std::uint32_t>(port)));
-      return *resolver.resolve(query);
+    // With coalescing on, a datagram that's sent by itself, rather than through write(), is framed as a coalesced datagram
+    // with just the one message in it, so that a deframed() receiver can still read it. Returns the length to frame, if so.
+    [[nodiscard]] static std::optional<std::size_t> _solo_frame(const kernel& k, std::size_t n) {
+      if (not k.pending) {
+        return std::nullopt;
+      }
+
+      if (n > max_framed_message) {
+        throw std::length_error{"message is too long to be coalesced"};
+      }
+
+      return n;
+    }
+
+    [[nodiscard]] static datagram_header _make_header(kernel& k, std::optional<std::size_t> frame = std::nullopt) {
+      auto header = datagram_header{};
+
+      if (k.probe) {
+        const auto stamp = k.probe->next();
+        std::memcpy(header.bytes.data(), stamp.data(), stamp.size());
+        header.size += stamp.size();
+      }
+
+      if (k.sequenced) {
+        const auto sequence = boost::endian::native_to_big(k.next_sequence.fetch_add(1, std::memory_order_relaxed));
+        std::memcpy(header.bytes.data() + header.size, &sequence, sizeof(sequence));
+        header.size += sizeof(sequence);
+      }
+
+      if (frame) {
+        write_frame_length(header.bytes.data() + header.size, *frame);
+        header.size += frame_header_size;
+      }
+
+      return header;
+    }
+
+    // Returns the number of bytes of data that were sent, not counting any header.
+    [[nodiscard]] static std::size_t _send(kernel& k,
+                                           const char* s,
+                                           std::size_t n,
+                                           std::optional<std::size_t> frame = std::nullopt) {
+      auto ec         = boost::system::error_code{};
+      const auto sent = _send(k, s, n, ec, frame);
+      if (ec) {
+        throw boost::system::system_error{ec};
+      }
+
+      return sent;
+    }
+
+    static std::size_t _send(kernel& k,
+                             const char* s,
+                             std::size_t n,
+                             boost::system::error_code& ec,
+                             std::optional<std::size_t> frame = std::nullopt) {
+      const auto header = _make_header(k, frame);
+      if (header.size == 0) {
+        return k.socket->send_to(boost::asio::buffer(s, n), k.endpoint, 0, ec);
+      }
+
+      const auto buffers = std::array{boost::asio::buffer(header.bytes.data(), header.size), boost::asio::buffer(s, n)};
+      const auto sent    = k.socket->send_to(buffers, k.endpoint, 0, ec);
+      return sent < header.size ? 0 : sent - header.size;
+    }
+
+    // A message that won't fit in what's left of the pending datagram sends that datagram first. A message that's too big
+    // for a datagram on its own is still framed, and goes in a datagram by itself.
+    static void _coalesce(const std::shared_ptr<kernel>& k, const char* s, std::size_t n) {
+      auto _     = std::unique_lock{k->coalesce_mtx};
+      auto& coal = *k->pending;
+
+      if (not coal.empty() and not coal.fits(n)) {
+        _send_pending_or_throw(*k);
+      }
+
+      coal.append(s, n);
+      if (coal.full()) {
+        _send_pending_or_throw(*k);
+      } else if (not std::exchange(k->coalesce_timer_armed, true)) {
+        _arm_coalesce_timer(k, coal.options().flush_after);
+      }
+    }
+
+    // Must be called with coalesce_mtx held.
+    static void _send_pending_or_throw(kernel& k) {
+      auto ec = boost::system::error_code{};
+      _send_pending(k, ec);
+      if (ec) {
+        throw boost::system::system_error{ec};
+      }
+    }
+
+    // Must be called with coalesce_mtx held.
+    static void _send_pending(kernel& k, boost::system::error_code& ec) {
+      auto& coal = *k.pending;
+      if (coal.empty()) {
+        return;
+      }
+
+      const auto datagram = coal.datagram();
+      std::ignore         = _send(k, datagram.data(), datagram.size(), ec);
+      coal.clear();
+    }
+
+    // Must be called with coalesce_mtx held.
+    static void _arm_coalesce_timer(const std::shared_ptr<kernel>& k, std::chrono::steady_clock::duration after) {
+      k->coalesce_timer->expires_after(after);
+      k->coalesce_timer->async_wait([k](const boost::system::error_code& err) {
+        if (not err) {
+          _on_coalesce_timer(k);
+        }
+      });
+    }
+
+    // The timer may have been armed for a datagram that has since been sent because it filled up, so the one that's pending
+    // now is only sent if it's been waiting long enough. Otherwise the timer is re-armed for when it will have been.
+    static void _on_coalesce_timer(const std::shared_ptr<kernel>& k) {
+      auto _                  = std::unique_lock{k->coalesce_mtx};
+      k->coalesce_timer_armed = false;
+
+      auto& coal = *k->pending;
+      if (coal.empty()) {
+        return;
+      }
+
+      const auto due = coal.started() + coal.options().flush_after;
+      if (const auto now = std::chrono::steady_clock::now(); now < due) {
+        k->coalesce_timer_armed = true;
+        _arm_coalesce_timer(k, due - now);
+        return;
+      }
+
+      // There's no-one on the io thread to report a failed send to, so the datagram is just lost, as it would be on the wire.
+      auto ec = boost::system::error_code{};
+      _send_pending(*k, ec);
+    }
+
+    // UDP sockets are bound to an ephemeral port; local datagram sockets can send without being bound at all.
+    [[nodiscard]] static std::shared_ptr<socket_type> _open(boost::asio::io_context& io) {
+      if constexpr (std::is_same_v<Protocol_T, boost::asio::ip::udp>) {
+        return std::make_shared<socket_type>(io, endpoint_type{boost::asio::ip::udp::v4(), 0});
+      } else {
+        return std::make_shared<socket_type>(io, Protocol_T{});
+      }
+    }
+
+    // The callback is held by a shared_ptr, since a std::function has to be copyable and the callback might not be.
+    template <async_send_fn_like Callback_T>
+    [[nodiscard]] static send_callback _make_send_callback(Callback_T&& callback) {
+      auto cb = std::make_shared<std::decay_t<Callback_T>>(std::forward<Callback_T>(callback));
+
+      if constexpr (std::is_invocable_v<std::decay_t<Callback_T>&, const boost::system::error_code&, size_t>) {
+        return [cb](const boost::system::error_code& ec, size_t n) { (*cb)(ec, n); };
+      } else {
+        // Callbacks that only take the number of bytes sent aren't told about failed sends.
+        return [cb](const boost::system::error_code& ec, size_t n) {
+          if (not ec) {
+            (*cb)(n);
+          }
+        };
+      }
+    }
+
+    // The front of the queue is never removed while it's in flight, so it's safe to use it outside the lock.
+    static void _send_front(const std::shared_ptr<kernel>& k) {
+      auto send_buf = boost::asio::const_buffer{};
+      {
+        auto _              = std::unique_lock{k->send_mtx};
+        send_buf            = k->send_queue.front().buffer;
+        k->in_flight_header = k->send_queue.front().header;
+      }
+
+      const auto header_size = k->in_flight_header.size;
+      if (header_size == 0) {
+        k->socket->async_send_to(send_buf, k->endpoint, [k](auto&& ec, size_t n) { _on_send_complete(k, ec, n); });
+        return;
+      }
+
+      const auto buffers = std::array{boost::asio::const_buffer{k->in_flight_header.bytes.data(), header_size}, send_buf};
+      k->socket->async_send_to(buffers, k->endpoint, [k, header_size](auto&& ec, size_t n) {
+        _on_send_complete(k, ec, n < header_size ? 0 : n - header_size);
+      });
+    }
+
+    static void _on_send_complete(const std::shared_ptr<kernel>& k, const boost::system::error_code& ec, size_t n) {
+      auto callbacks_to_run = std::vector<completed_send>{};
+      auto send_next        = false;
+
+      {
+        auto _ = std::unique_lock{k->send_mtx};
+
+        k->completed_sends.push_back({std::move(k->send_queue.front().callback), ec, n});
+        k->send_queue.pop_front();
+
+        send_next           = not k->send_queue.empty();
+        k->send_in_progress = send_next;
+
+        if (not send_next or k->completed_sends.size() >= k->send_opts.completion_batch) {
+          callbacks_to_run.swap(k->completed_sends);
+        }
+      }
+
+      k->send_space_available.notify_all();
+
+      if (send_next) {
+        _send_front(k);
+      }
+
+      for (auto& done : callbacks_to_run) {
+        done.callback(done.ec, done.n);
+      }
     }
 
     std::shared_ptr<kernel> _out_kernel;
   };
+
+  using sink = basic_sink<boost::asio::ip::udp>;
 }  // namespace detail
 
 using ostreambuf = boost::iostreams::stream_buffer<detail::sink>;
-class ostream : public boost::iostreams::stream<detail::sink> {
+class ostream : public boost::iostreams::stream<detail::sink>, public datagram_ostream<ostream> {
  public:
-  explicit ostream(boost::asio::io_context& io, std::string host, std::uint16_t port)
-      : boost::iostreams::stream<detail::sink>{io, std::move(host), port} {}
+  explicit ostream(boost::asio::io_context& io,
+                   std::string host,
+                   std::uint16_t port,
+                   send_queue_options send_opts = send_queue_options{})
+      : boost::iostreams::stream<detail::sink>{
+            detail::sink{io, detail::resolve_endpoint(io, std::move(host), port), send_opts}} {}
+
+  explicit ostream(boost::asio::io_context& io,
+                   std::shared_ptr<boost::asio::ip::udp::socket> socket,
+                   std::string host,
+                   std::uint16_t port,
+                   send_queue_options send_opts = send_queue_options{})
+      : boost::iostreams::stream<detail::sink>{
+            detail::sink{io, std::move(socket), detail::resolve_endpoint(io, std::move(host), port), send_opts}} {}
 };
 
 struct flush_t {};
@@ -108,20 +678,4 @@ inline std::ostream& operator<<(std::ostream& os, const flush_t&) {
   return os;
 }
 
-template <contiguous_byte_range_like Range_T>
-  requires(not std::is_same_v<std::string, std::decay_t<Range_T>>)
-ostream& operator<<(ostream& os, Range_T&& bytes) {
-  if (not bytes.empty()) {
-    os.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
-  }
-
-  return os;
-}
-
-template <typename Data_T, async_send_fn_like Callback_T>
-ostream& operator<<(ostream& os, std::pair<Data_T, Callback_T>&& data_and_callback) {
-  os->async_write(std::forward<std::pair<Data_T, Callback_T>>(data_and_callback));
-  return os;
-}
-
 }  // namespace nsl::udp
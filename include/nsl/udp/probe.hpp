@@ -0,0 +1,199 @@
+#pragma once
+
+#include <boost/endian/conversion.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <ostream>
+
+namespace nsl::udp {
+
+// Records latencies into log-linear buckets, in the style of an HDR histogram: each power of two is split into
+// sub_bucket_count equal buckets, so every recorded value is kept to within about 3% of its true value, whatever its size.
+// Recording is lock-free, so the histogram can be read (or exported) while a stream is recording into it.
+class latency_histogram {
+ public:
+  static constexpr auto sub_bucket_bits  = 5u;
+  static constexpr auto sub_bucket_count = std::uint64_t{1} << sub_bucket_bits;
+  static constexpr auto bucket_count     = (64 - sub_bucket_bits + 1) * sub_bucket_count;
+
+  void record(std::chrono::nanoseconds latency) noexcept {
+    const auto value = static_cast<std::uint64_t>(std::max(latency.count(), std::chrono::nanoseconds::rep{0}));
+
+    _counts[_index_of(value)].fetch_add(1, std::memory_order_relaxed);
+    _total.fetch_add(1, std::memory_order_relaxed);
+
+    auto min = _min.load(std::memory_order_relaxed);
+    while (value < min and not _min.compare_exchange_weak(min, value, std::memory_order_relaxed)) {
+    }
+
+    auto max = _max.load(std::memory_order_relaxed);
+    while (value > max and not _max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+  }
+
+  [[nodiscard]] std::uint64_t count() const noexcept { return _total.load(std::memory_order_relaxed); }
+
+  [[nodiscard]] std::chrono::nanoseconds min() const noexcept {
+    return count() == 0 ? std::chrono::nanoseconds{0} : _as_duration(_min.load(std::memory_order_relaxed));
+  }
+
+  [[nodiscard]] std::chrono::nanoseconds max() const noexcept { return _as_duration(_max.load(std::memory_order_relaxed)); }
+
+  // The smallest recorded latency that at least percent% of the recorded latencies are no greater than, to the resolution
+  // of the buckets.
+  [[nodiscard]] std::chrono::nanoseconds percentile(double percent) const noexcept {
+    const auto total = count();
+    if (total == 0) {
+      return std::chrono::nanoseconds{0};
+    }
+
+    const auto wanted = std::ceil(std::clamp(percent, 0.0, 100.0) / 100.0 * static_cast<double>(total));
+    const auto target = std::max(std::uint64_t{1}, static_cast<std::uint64_t>(wanted));
+
+    auto seen = std::uint64_t{0};
+    for (auto i = std::size_t{0}; i < bucket_count; ++i) {
+      seen += _counts[i].load(std::memory_order_relaxed);
+      if (seen >= target) {
+        return std::min(_as_duration(_highest_in(i)), max());
+      }
+    }
+
+    return max();
+  }
+
+  // Writes one line per non-empty bucket: the highest latency (in nanoseconds) that the bucket holds, and the number of
+  // latencies that were recorded into it.
+  void export_to(std::ostream& os) const {
+    for (auto i = std::size_t{0}; i < bucket_count; ++i) {
+      if (const auto n = _counts[i].load(std::memory_order_relaxed); n != 0) {
+        os << _highest_in(i) << ' ' << n << '\n';
+      }
+    }
+  }
+
+  void reset() noexcept {
+    for (auto& n : _counts) {
+      n.store(0, std::memory_order_relaxed);
+    }
+
+    _total.store(0, std::memory_order_relaxed);
+    _min.store(std::numeric_limits<std::uint64_t>::max(), std::memory_order_relaxed);
+    _max.store(0, std::memory_order_relaxed);
+  }
+
+ private:
+  // Values below sub_bucket_count each get a bucket of their own. Above that, the buckets for the power of two [2^m, 2^(m+1))
+  // are each 2^(m - sub_bucket_bits) wide.
+  [[nodiscard]] static constexpr std::size_t _index_of(std::uint64_t value) noexcept {
+    if (value < sub_bucket_count) {
+      return static_cast<std::size_t>(value);
+    }
+
+    const auto shift = static_cast<unsigned>(std::bit_width(value)) - 1 - sub_bucket_bits;
+    return static_cast<std::size_t>((shift + 1) * sub_bucket_count + ((value >> shift) - sub_bucket_count));
+  }
+
+  [[nodiscard]] static constexpr std::uint64_t _highest_in(std::size_t index) noexcept {
+    if (index < sub_bucket_count) {
+      return index;
+    }
+
+    const auto shift = index / sub_bucket_count - 1;
+    const auto sub   = index % sub_bucket_count + sub_bucket_count;
+    return ((sub + 1) << shift) - 1;
+  }
+
+  [[nodiscard]] static std::chrono::nanoseconds _as_duration(std::uint64_t value) noexcept {
+    return std::chrono::nanoseconds{
+        static_cast<std::chrono::nanoseconds::rep>(std::min<std::uint64_t>(value, std::numeric_limits<std::int64_t>::max()))};
+  }
+
+  std::array<std::atomic<std::uint64_t>, bucket_count> _counts{};
+  std::atomic<std::uint64_t> _total{0};
+  std::atomic<std::uint64_t> _min{std::numeric_limits<std::uint64_t>::max()};
+  std::atomic<std::uint64_t> _max{0};
+};
+
+struct probe_options {
+  std::uint32_t sample_every = 64;  // Every Nth datagram carries a send timestamp.
+};
+
+namespace detail {
+
+  // With the probe enabled, every datagram starts with this header: flags, a sequence number and (if the datagram was
+  // sampled) the time that it was written, in nanoseconds since the sender's system_clock epoch. Integers are big-endian,
+  // like the sequence number and frame lengths, so that hosts of different kinds agree on them.
+  constexpr auto probe_header_size = std::size_t{16};
+  constexpr auto probe_sampled     = std::uint32_t{1};
+
+  using probe_stamp = std::array<char, probe_header_size>;
+
+  // The wall clock, rather than steady_clock, since steady_clock's epoch is different on every host (and every boot), which
+  // would make the difference between a sender's stamp and a receiver's meaningless.
+  [[nodiscard]] inline std::uint64_t probe_clock_now() noexcept {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+  }
+
+  class probe_stamper {
+   public:
+    explicit probe_stamper(probe_options opts) : _sample_every{std::max(opts.sample_every, std::uint32_t{1})} {}
+
+    [[nodiscard]] probe_stamp next() noexcept {
+      const auto seq   = _seq.fetch_add(1, std::memory_order_relaxed);
+      const auto flags = seq % _sample_every == 0 ? probe_sampled : std::uint32_t{0};
+      const auto sent  = flags == probe_sampled ? probe_clock_now() : std::uint64_t{0};
+
+      const auto wire_flags = boost::endian::native_to_big(flags);
+      const auto wire_seq   = boost::endian::native_to_big(seq);
+      const auto wire_sent  = boost::endian::native_to_big(sent);
+
+      auto stamp = probe_stamp{};
+      std::memcpy(stamp.data(), &wire_flags, sizeof(wire_flags));
+      std::memcpy(stamp.data() + sizeof(wire_flags), &wire_seq, sizeof(wire_seq));
+      std::memcpy(stamp.data() + sizeof(wire_flags) + sizeof(wire_seq), &wire_sent, sizeof(wire_sent));
+      return stamp;
+    }
+
+   private:
+    std::uint32_t _sample_every;
+    std::atomic<std::uint32_t> _seq{0};
+  };
+
+  // The time since a sampled datagram was written, or nothing if the datagram wasn't sampled. Between hosts, this is only
+  // as good as the sync between their clocks. A datagram that seems to have arrived before it was sent (because the
+  // sender's clock is ahead of the receiver's) is taken to have arrived straight away.
+  [[nodiscard]] inline std::optional<std::chrono::nanoseconds> probe_latency(const char* header) noexcept {
+    auto flags = std::uint32_t{0};
+    auto sent  = std::uint64_t{0};
+    std::memcpy(&flags, header, sizeof(flags));
+    std::memcpy(&sent, header + 2 * sizeof(std::uint32_t), sizeof(sent));
+    boost::endian::big_to_native_inplace(flags);
+    boost::endian::big_to_native_inplace(sent);
+
+    if ((flags & probe_sampled) == 0) {
+      return std::nullopt;
+    }
+
+    const auto now = probe_clock_now();
+    if (now < sent) {
+      return std::chrono::nanoseconds{0};
+    }
+
+    return std::chrono::nanoseconds{static_cast<std::chrono::nanoseconds::rep>(
+        std::min<std::uint64_t>(now - sent, std::numeric_limits<std::chrono::nanoseconds::rep>::max()))};
+  }
+
+}  // namespace detail
+
+}  // namespace nsl::udp
@@ -0,0 +1,205 @@
+#pragma once
+
+#include "resolve.hpp"
+#include "types.hpp"
+
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/stream.hpp>
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <istream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace nsl::udp {
+
+struct receive_group_options {
+  std::size_t thread_count = 1;   // The threads that service every port in the group.
+  std::size_t batch_limit  = 64;  // The most datagrams read from one port before the other ready ports get a turn.
+};
+
+// Receives on many ports from a small, fixed set of threads. Each port is just a non-blocking socket and a callback: nothing
+// is posted to the socket until it's readable, and then everything that it has waiting (up to batch_limit datagrams) is
+// read and handed to the callback in one go. The waiting is done by the io_context's reactor (epoll on Linux), which picks
+// up every ready socket from a single wait, so the cost scales with the traffic rather than with the number of ports.
+//
+// A port's callback is never called on two threads at once, but the callbacks of different ports can run concurrently if
+// there's more than one thread.
+class receive_group {
+  struct member {
+    member(boost::asio::io_context& io,
+           const boost::asio::ip::udp::endpoint& endpoint,
+           std::function<void(std::istream&, size_t)> cb)
+        : strand{boost::asio::make_strand(io)}, socket{strand, endpoint}, callback{std::move(cb)} {
+      socket.non_blocking(true);
+    }
+
+    boost::asio::strand<boost::asio::io_context::executor_type> strand;
+    boost::asio::ip::udp::socket socket;
+    std::function<void(std::istream&, size_t)> callback;
+  };
+
+ public:
+  explicit receive_group(receive_group_options opts = {}) : _batch_limit{std::max(opts.batch_limit, std::size_t{1})} {
+    const auto thread_count = std::max(opts.thread_count, std::size_t{1});
+    _threads.reserve(thread_count);
+
+    try {
+      for (auto i = std::size_t{0}; i < thread_count; ++i) {
+        _threads.emplace_back([this]() { _io.run(); });
+      }
+    } catch (...) {
+      stop();
+      throw;
+    }
+  }
+
+  receive_group(const receive_group&)            = delete;
+  receive_group& operator=(const receive_group&) = delete;
+  receive_group(receive_group&&)                 = delete;
+  receive_group& operator=(receive_group&&)      = delete;
+
+  ~receive_group() { stop(); }
+
+  // Binds the port and starts handing its datagrams to the callback. Returns the port that was bound, which is only
+  // different from the one asked for if that was any_port.
+  template <async_recv_fn_like Callback_T>
+  port_number add(port_number port, Callback_T&& callback) {
+    auto cb = [fn = std::make_shared<std::decay_t<Callback_T>>(std::forward<Callback_T>(callback))](std::istream& is, size_t n) {
+      (*fn)(is, n);
+    };
+
+    auto m = std::make_shared<member>(_io, detail::resolve_endpoint(_io, "0.0.0.0", port), std::move(cb));
+    const auto bound = m->socket.local_endpoint().port();
+
+    {
+      auto _ = std::unique_lock{_mtx};
+      _members.emplace(bound, m);
+    }
+
+    boost::asio::dispatch(m->strand, [this, m]() { _wait(m); });
+
+    return bound;
+  }
+
+  // Stops receiving on the port and closes it. When this is called from outside the group's threads, it waits for any call
+  // to the port's callback that's in progress to return first; if the group is stopped in the meantime, the port is closed
+  // here once the threads have finished. Returns false if the port isn't in the group.
+  bool remove(port_number port) {
+    auto m = std::shared_ptr<member>{};
+    {
+      auto _  = std::unique_lock{_mtx};
+      auto it = _members.find(port);
+      if (it == _members.end()) {
+        return false;
+      }
+
+      m = std::move(it->second);
+      _members.erase(it);
+    }
+
+    auto closed = std::make_shared<bool>(false);
+    boost::asio::dispatch(m->strand, [this, m, closed]() {
+      auto ec = boost::system::error_code{};
+      m->socket.close(ec);
+
+      auto _  = std::unique_lock{_mtx};
+      *closed = true;
+      _state_changed.notify_all();
+    });
+
+    if (_io.get_executor().running_in_this_thread()) {
+      return true;
+    }
+
+    auto lock = std::unique_lock{_mtx};
+    _state_changed.wait(lock, [&]() { return *closed or _stopped; });
+    if (not *closed) {
+      // The group stopped before the removal got a turn, and its threads are gone, so nothing else can touch the socket.
+      auto ec = boost::system::error_code{};
+      m->socket.close(ec);
+    }
+
+    return true;
+  }
+
+  [[nodiscard]] std::size_t size() const {
+    auto _ = std::unique_lock{_mtx};
+    return _members.size();
+  }
+
+  [[nodiscard]] std::size_t thread_count() const noexcept { return _threads.size(); }
+
+  // Stops the threads. Anything that's waiting to be received is abandoned. Safe to call more than once.
+  void stop() {
+    _work.reset();
+    _io.stop();
+
+    for (auto& thread : _threads) {
+      if (thread.joinable()) {
+        thread.join();
+      }
+    }
+
+    auto _   = std::unique_lock{_mtx};
+    _stopped = true;
+    _state_changed.notify_all();
+  }
+
+ private:
+  // The socket is only waited on, rather than read into a buffer of its own, so an idle port costs nothing but its socket.
+  void _wait(std::shared_ptr<member> m) {
+    m->socket.async_wait(boost::asio::ip::udp::socket::wait_read,
+                         boost::asio::bind_executor(m->strand, [this, m](const boost::system::error_code& err) {
+                           if (err or not m->socket.is_open()) {
+                             return;
+                           }
+
+                           _drain(*m);
+                           _wait(m);
+                         }));
+  }
+
+  void _drain(member& m) {
+    // One buffer per thread, big enough for any UDP datagram, is shared by all the ports that the thread services.
+    thread_local auto buffer = std::array<char, 65536>{};
+
+    for (auto i = std::size_t{0}; i < _batch_limit; ++i) {
+      auto ec      = boost::system::error_code{};
+      const auto n = m.socket.receive(boost::asio::buffer(buffer), 0, ec);
+      if (ec) {
+        return;
+      }
+
+      auto data_stream = boost::iostreams::stream<boost::iostreams::array_source>{buffer.data(), n};
+      m.callback(data_stream, n);
+    }
+  }
+
+  boost::asio::io_context _io{};
+  std::optional<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> _work{_io.get_executor()};
+  std::size_t _batch_limit;
+  mutable std::mutex _mtx;
+  std::condition_variable _state_changed;  // Signalled when a removal has closed its port, and when the group has stopped.
+  bool _stopped = false;
+  std::map<port_number, std::shared_ptr<member>> _members;
+  std::vector<std::thread> _threads;
+};
+
+}  // namespace nsl::udp
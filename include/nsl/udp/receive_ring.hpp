@@ -0,0 +1,82 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace nsl::udp {
+
+// The largest datagram that can be received without being truncated (the most that fits in a UDP datagram, rounded up).
+constexpr auto max_datagram_size = std::size_t{65536};
+
+struct receive_ring_options {
+  std::size_t depth       = 8;                  // How many receives are kept posted on the socket at once.
+  std::size_t buffer_size = max_datagram_size;  // Bytes in each receive buffer. Longer datagrams are truncated.
+};
+
+template <async_recv_fn_like Callback_T>
+struct ring_recv_fn {
+  receive_ring_options options;
+  Callback_T callback;
+};
+
+// Wraps an async receive callback so that depth receives are kept posted on the socket, each into its own buffer from a
+// ring that's allocated up front. The kernel always has somewhere to put the next datagram while the callback is handling
+// the last one. The callback is still called one datagram at a time, in the order they arrived.
+template <async_recv_fn_like Callback_T>
+[[nodiscard]] ring_recv_fn<std::decay_t<Callback_T>> receive_ring(Callback_T&& callback, receive_ring_options opts = {}) {
+  return {opts, std::forward<Callback_T>(callback)};
+}
+
+namespace detail {
+
+  // The buffers for a ring of receives, in one allocation. Receive i always goes into slot i % depth, and the slots are
+  // re-posted in the order that they're delivered, so the slot that holds the next datagram to deliver is always known.
+  class receive_ring_slots {
+   public:
+    explicit receive_ring_slots(receive_ring_options opts)
+        : _depth{std::max(opts.depth, std::size_t{1})}
+        , _buffer_size{std::max(opts.buffer_size, std::size_t{1})}
+        , _storage(_depth * _buffer_size)
+        , _received(_depth) {}
+
+    [[nodiscard]] std::size_t depth() const noexcept { return _depth; }
+
+    [[nodiscard]] std::span<char> buffer(std::size_t slot) noexcept {
+      return {_storage.data() + slot * _buffer_size, _buffer_size};
+    }
+
+    void fill(std::size_t slot, std::size_t n) noexcept { _received[slot] = n; }
+
+    // The slot that's next in line, and the size of its datagram, if its receive has completed.
+    [[nodiscard]] std::optional<std::pair<std::size_t, std::size_t>> next_filled() const noexcept {
+      if (const auto& n = _received[_next]) {
+        return std::pair{_next, *n};
+      }
+
+      return std::nullopt;
+    }
+
+    // Marks the next slot's datagram as delivered and moves on to the slot after it.
+    void advance() noexcept {
+      _received[_next].reset();
+      _next = (_next + 1) % _depth;
+    }
+
+   private:
+    std::size_t _depth;
+    std::size_t _buffer_size;
+    std::vector<char> _storage;
+    std::vector<std::optional<std::size_t>> _received;
+    std::size_t _next{0};
+  };
+
+}  // namespace detail
+
+}  // namespace nsl::udp
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/udp.hpp>
+
+#include <cstdint>
+#include <string>
+
+namespace nsl::udp::detail {
+
+[[nodiscard]] inline boost::asio::ip::udp::endpoint resolve_endpoint(boost::asio::io_context& io,
+                                                                     std::string host,
+                                                                     port_number port) {
+  boost::asio::ip::udp::resolver resolver(io);
+  boost::asio::ip::udp::resolver::query query(
+      boost::asio::ip::udp::v4(), host, std::to_string(static_cast<std::uint32_t>(port)));
+  return *resolver.resolve(query);
+}
+
+}  // namespace nsl::udp::detail
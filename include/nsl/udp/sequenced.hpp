@@ -0,0 +1,244 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <boost/endian/conversion.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/stream.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace nsl::udp {
+
+struct sequenced_options {
+  std::size_t window            = 64;    // How many datagrams can be held back waiting for a missing one.
+  std::size_t max_datagram_size = 2048;  // Datagrams that arrive early and are bigger than this are dropped.
+};
+
+struct sequenced_stats {
+  std::uint64_t delivered  = 0;
+  std::uint64_t reordered  = 0;  // Arrived early and were held back until the ones before them were delivered.
+  std::uint64_t lost       = 0;  // Skipped over, and reported to the gap handler.
+  std::uint64_t late       = 0;  // Arrived after they'd been reported lost, and were dropped.
+  std::uint64_t duplicates = 0;  // Arrived again after they'd been delivered (or while they were being held), and were dropped.
+  std::uint64_t oversized  = 0;  // Arrived early, but were too big to hold, so were dropped. They aren't counted as lost.
+};
+
+// The default gap handler, for when the stats are all you need.
+struct ignore_gaps {
+  void operator()(std::uint64_t, std::uint64_t) const noexcept {}
+};
+
+namespace detail {
+
+  // With sequencing on, every datagram (after any probe header) starts with its 8-byte sequence number, big-endian, so that
+  // senders and receivers on different kinds of machine agree on it. The first datagram that a sender sends is number 0.
+  constexpr auto sequence_header_size = sizeof(std::uint64_t);
+
+  // The receiving end of a sequenced feed. All the storage that it needs is allocated up front: window slots of
+  // max_datagram_size bytes for datagrams that arrive early, and the numbers of the last window datagrams delivered, for
+  // telling duplicates from late arrivals.
+  class sequencer {
+    struct slot {
+      std::uint64_t sequence{0};
+      std::size_t size{0};
+      bool filled{false};
+      bool oversized{false};  // It arrived, but there was no room to keep it, so its turn is skipped without a gap.
+    };
+
+   public:
+    explicit sequencer(sequenced_options opts)
+        : _opts{std::max(opts.window, std::size_t{1}), opts.max_datagram_size}
+        , _slots(_opts.window)
+        , _storage(_opts.window * _opts.max_datagram_size)
+        , _history(_opts.window, never_delivered) {}
+
+    // Called with each datagram's sequence number and the rest of its data, on the thread doing the receiving.
+    template <typename Deliver_T, typename Gap_T>
+    void accept(std::uint64_t sequence, std::istream& is, std::size_t n, Deliver_T& deliver, Gap_T& on_gap) {
+      if (not _started) {
+        _started = true;
+        _next    = sequence;
+      }
+
+      if (sequence < _next) {
+        const auto was_delivered = _next - sequence <= _opts.window and _history[sequence % _opts.window] == sequence;
+        ++(was_delivered ? _duplicates : _late);
+        return;
+      }
+
+      // If the window can't reach this far, give up on whatever's missing from the front of it.
+      while (sequence >= _next + _opts.window) {
+        if (_held == 0) {
+          on_gap(_next, sequence - _next);
+          _lost += sequence - _next;
+          _next = sequence;
+          break;
+        }
+
+        _skip_front(deliver, on_gap);
+      }
+
+      if (sequence == _next) {
+        _deliver(sequence, is, n, deliver);
+        _drain(deliver);
+        return;
+      }
+
+      auto& s = _slots[sequence % _opts.window];
+      if (s.filled) {
+        ++_duplicates;
+        return;
+      }
+
+      if (n > _opts.max_datagram_size) {
+        s = slot{sequence, 0, true, true};
+        ++_held;
+        ++_oversized;
+        return;
+      }
+
+      is.read(_slot_data(sequence), static_cast<std::streamsize>(n));
+      s = slot{sequence, n, true};
+      ++_held;
+      ++_reordered;
+    }
+
+    // Gives up on everything that's missing in front of the datagrams that are being held, and delivers them.
+    template <typename Deliver_T, typename Gap_T>
+    void skip_gaps(Deliver_T& deliver, Gap_T& on_gap) {
+      while (_held > 0) {
+        _skip_front(deliver, on_gap);
+      }
+    }
+
+    [[nodiscard]] sequenced_stats stats() const noexcept {
+      return {_delivered.load(), _reordered.load(), _lost.load(), _late.load(), _duplicates.load(), _oversized.load()};
+    }
+
+   private:
+    static constexpr auto never_delivered = ~std::uint64_t{0};
+
+    template <typename Deliver_T>
+    void _deliver(std::uint64_t sequence, std::istream& is, std::size_t n, Deliver_T& deliver) {
+      deliver(is, n);
+
+      _history[sequence % _opts.window] = sequence;
+      ++_delivered;
+      ++_next;
+    }
+
+    template <typename Deliver_T>
+    void _drain(Deliver_T& deliver) {
+      for (auto* s = &_slots[_next % _opts.window]; s->filled and s->sequence == _next; s = &_slots[_next % _opts.window]) {
+        s->filled = false;
+        --_held;
+
+        if (s->oversized) {
+          _history[_next % _opts.window] = _next;
+          ++_next;
+          continue;
+        }
+
+        auto data_stream = boost::iostreams::stream<boost::iostreams::array_source>{_slot_data(_next), s->size};
+        _deliver(_next, data_stream, s->size, deliver);
+      }
+    }
+
+    template <typename Deliver_T, typename Gap_T>
+    void _skip_front(Deliver_T& deliver, Gap_T& on_gap) {
+      auto missing = std::uint64_t{0};
+      while (not _slots[(_next + missing) % _opts.window].filled and missing < _opts.window) {
+        ++missing;
+      }
+
+      on_gap(_next, missing);
+      _lost += missing;
+      _next += missing;
+
+      _drain(deliver);
+    }
+
+    [[nodiscard]] char* _slot_data(std::uint64_t sequence) noexcept {
+      return _storage.data() + (sequence % _opts.window) * _opts.max_datagram_size;
+    }
+
+    sequenced_options _opts;
+    std::vector<slot> _slots;
+    std::vector<char> _storage;
+    std::vector<std::uint64_t> _history;
+    bool _started{false};
+    std::uint64_t _next{0};
+    std::size_t _held{0};
+
+    std::atomic<std::uint64_t> _delivered{0};
+    std::atomic<std::uint64_t> _reordered{0};
+    std::atomic<std::uint64_t> _lost{0};
+    std::atomic<std::uint64_t> _late{0};
+    std::atomic<std::uint64_t> _duplicates{0};
+    std::atomic<std::uint64_t> _oversized{0};
+  };
+
+}  // namespace detail
+
+// Wraps a receive callback so that it's handed a sequenced feed's datagrams in order, without their sequence numbers. Copies
+// share the same window, so keep one to read the stats from, and to skip the gaps with.
+template <async_recv_fn_like Callback_T, typename Gap_T = ignore_gaps>
+class sequenced_recv_fn {
+ public:
+  sequenced_recv_fn(Callback_T callback, sequenced_options opts, Gap_T on_gap)
+      : _state{std::make_shared<state>(std::move(callback), opts, std::move(on_gap))} {}
+
+  void operator()(std::istream& is, size_t n) {
+    if (n < detail::sequence_header_size) {
+      return;
+    }
+
+    auto sequence = std::uint64_t{0};
+    is.read(reinterpret_cast<char*>(&sequence), sizeof(sequence));
+    boost::endian::big_to_native_inplace(sequence);
+
+    auto _ = std::unique_lock{_state->mtx};
+    _state->window.accept(sequence, is, n - detail::sequence_header_size, _state->callback, _state->on_gap);
+  }
+
+  // A gap is otherwise only given up on once the window has filled up behind it, which can take a long time on a quiet feed.
+  // Call this (from a timer, say) to report whatever's missing to the gap handler now, and deliver what's being held.
+  void skip_gaps() {
+    auto _ = std::unique_lock{_state->mtx};
+    _state->window.skip_gaps(_state->callback, _state->on_gap);
+  }
+
+  [[nodiscard]] sequenced_stats stats() const noexcept { return _state->window.stats(); }
+
+ private:
+  struct state {
+    state(Callback_T cb, sequenced_options opts, Gap_T gap) : callback{std::move(cb)}, on_gap{std::move(gap)}, window{opts} {}
+
+    std::mutex mtx;  // So that skip_gaps() can be called from another thread than the one doing the receiving.
+    Callback_T callback;
+    Gap_T on_gap;
+    detail::sequencer window;
+  };
+
+  std::shared_ptr<state> _state;
+};
+
+// on_gap is called with the first sequence number of each run of datagrams that's given up on, and how many there are.
+template <async_recv_fn_like Callback_T, typename Gap_T = ignore_gaps>
+[[nodiscard]] sequenced_recv_fn<std::decay_t<Callback_T>, std::decay_t<Gap_T>> sequenced(Callback_T&& callback,
+                                                                                        sequenced_options opts = {},
+                                                                                        Gap_T&& on_gap = {}) {
+  return {std::forward<Callback_T>(callback), opts, std::forward<Gap_T>(on_gap)};
+}
+
+}  // namespace nsl::udp
@@ -5,10 +5,34 @@
 
 namespace nsl::udp {
 
+// Both directions use the one socket, bound to local_port, so peers see replies coming from the port that they send to.
+// Cancelling an async receive cancels just the receive operations on it, so any async sends in flight carry on.
 class stream : public istream, public ostream {
  public:
-  explicit stream(boost::asio::io_context& io, port_number local_port, std::string remote_host, port_number remote_port)
-      : istream{io, local_port}, ostream{io, std::move(remote_host), remote_port} {}
+  explicit stream(boost::asio::io_context& io,
+                  port_number local_port,
+                  std::string remote_host,
+                  port_number remote_port,
+                  send_queue_options send_opts = send_queue_options{})
+      : stream{io,
+               detail::bind_socket(io, detail::resolve_endpoint(io, "0.0.0.0", local_port)),
+               std::move(remote_host),
+               remote_port,
+               send_opts} {}
+
+  // Probes both directions: datagrams sent are stamped, and the latency of the ones received from a probing peer is recorded.
+  std::shared_ptr<latency_histogram> enable_latency_probe(probe_options opts = probe_options{}) {
+    ostream::enable_latency_probe(opts);
+    return istream::enable_latency_probe();
+  }
+
+ private:
+  explicit stream(boost::asio::io_context& io,
+                  std::shared_ptr<boost::asio::ip::udp::socket> socket,
+                  std::string remote_host,
+                  port_number remote_port,
+                  send_queue_options send_opts)
+      : istream{io, socket}, ostream{io, socket, std::move(remote_host), remote_port, send_opts} {}
 };
 
 }  // namespace nsl::udp
@@ -1,11 +1,23 @@
 #pragma once
 
+#include "probe.hpp"
+
+#include <boost/system/error_code.hpp>
 #include <wite/io/concepts.hpp>
 
+#include <array>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <ios>
 #include <istream>
+#include <memory>
+#include <span>
+#include <string>
 #include <tuple>
 #include <type_traits>
+#include <utility>
 
 namespace nsl::udp {
 
@@ -22,6 +34,13 @@ concept contiguous_byte_range_like = requires(T& t) {
                                        std::ignore = t.data();
                                      };
 
+// A range of byte ranges, like a std::array of std::spans, that are sent together as the pieces of one datagram.
+template <typename T>
+concept byte_range_sequence_like = requires(T& t) {
+                                     std::ignore = t.begin();
+                                     std::ignore = t.end();
+                                   } and contiguous_byte_range_like<std::remove_cvref_t<decltype(*std::declval<T&>().begin())>>;
+
 namespace detail {
 
   // Trick from https://stackoverflow.com/a/41272560
@@ -33,6 +52,241 @@ template <typename T>
 concept async_recv_fn_like = requires(T& t) { t(detail::make_lval<std::istream>(), size_t{0}); };
 
 template <typename T>
-concept async_send_fn_like = requires(T& t) { t(size_t{0}); };
+concept async_send_fn_like = requires(T& t) { t(size_t{0}); } or requires(T& t) { t(boost::system::error_code{}, size_t{0}); };
+
+// The pieces of a datagram that live in separate buffers, to be sent together without being copied into one first.
+template <std::size_t N>
+struct gathered_datagram {
+  std::array<std::span<const char>, N> pieces;
+};
+
+namespace detail {
+
+  template <contiguous_byte_range_like Range_T>
+  [[nodiscard]] std::span<const char> as_chars(const Range_T& bytes) {
+    return {reinterpret_cast<const char*>(bytes.data()), bytes.size() * sizeof(typename std::decay_t<Range_T>::value_type)};
+  }
+
+}  // namespace detail
+
+struct coalesce_options {
+  std::size_t max_datagram_size = 1400;        // Messages are packed into a datagram until the next one won't fit.
+  std::chrono::microseconds flush_after{100};  // The longest that a message waits for others to share its datagram.
+};
+
+enum class recv_status {
+  ok,           // A datagram was read.
+  would_block,  // try_read found nothing waiting to be read.
+  timed_out,    // Nothing arrived before the deadline.
+  error         // See recv_result::error.
+};
+
+struct recv_result {
+  recv_status status = recv_status::error;
+  std::size_t size   = 0;
+  boost::system::error_code error{};
+
+  explicit operator bool() const noexcept { return status == recv_status::ok; }
+};
+
+// Something that gets to see every datagram that an istream receives, before the datagram is handed over to the reader.
+using receive_tap = std::function<void(std::span<const char>)>;
+
+// The operators and members that every kind of datagram ostream shares. A stream class gets them by deriving from
+// datagram_ostream<itself>. The ones that its sink can't back (because it can't send asynchronously, say) are never picked,
+// and a stream that needs something different (like shm::ostream's prepare()) declares its own, which hides the one here.
+template <typename Stream_T>
+class datagram_ostream {
+ public:
+  void enable_latency_probe(probe_options opts = probe_options{})
+    requires requires(Stream_T& os, probe_options opts) { os->enable_latency_probe(opts); }
+  {
+    _self()->enable_latency_probe(opts);
+  }
+
+  void enable_sequencing()
+    requires requires(Stream_T& os) { os->enable_sequencing(); }
+  {
+    _self()->enable_sequencing();
+  }
+
+  void enable_coalescing(coalesce_options opts = coalesce_options{})
+    requires requires(Stream_T& os, coalesce_options opts) { os->enable_coalescing(opts); }
+  {
+    _self()->enable_coalescing(opts);
+  }
+
+  // Anything that's still buffered in the stream is coalesced first, so that it goes in the datagram that's sent.
+  void flush_coalesced()
+    requires requires(Stream_T& os) { os->flush_coalesced(); }
+  {
+    _self().flush();
+    _self()->flush_coalesced();
+  }
+
+  [[nodiscard]] std::span<char> prepare(std::size_t n)
+    requires requires(Stream_T& os, std::size_t n) { os->prepare(n); }
+  {
+    return _self()->prepare(n);
+  }
+
+  // Anything that's still buffered in the stream is sent first, so that datagrams go out in the order they were written.
+  std::size_t commit(std::size_t n)
+    requires requires(Stream_T& os, std::size_t n) { os->commit(n); }
+  {
+    _self().flush();
+    return _self()->commit(n);
+  }
+
+  // Sends the pieces (a header and a payload, say) as one datagram, without copying them together first. Returns the
+  // number of bytes sent.
+  template <contiguous_byte_range_like... Ranges_T>
+    requires(sizeof...(Ranges_T) > 0 and (not byte_range_sequence_like<Ranges_T> and ...))
+  std::size_t send(const Ranges_T&... pieces) {
+    return send(std::array{detail::as_chars(pieces)...});
+  }
+
+  // A failed send sets the stream's badbit, and returns 0.
+  template <byte_range_sequence_like Pieces_T>
+    requires requires(Stream_T& os, const Pieces_T& pieces, boost::system::error_code& ec) { os->send_gathered(pieces, ec); }
+  std::size_t send(const Pieces_T& pieces) {
+    _self().flush();
+
+    auto ec         = boost::system::error_code{};
+    const auto sent = _self()->send_gathered(pieces, ec);
+    if (ec) {
+      _self().setstate(std::ios::badbit);
+    }
+
+    return sent;
+  }
+
+ private:
+  [[nodiscard]] Stream_T& _self() noexcept { return static_cast<Stream_T&>(*this); }
+
+  template <contiguous_byte_range_like Range_T>
+    requires(not std::is_same_v<std::string, std::decay_t<Range_T>>)
+  friend Stream_T& operator<<(Stream_T& os, Range_T&& bytes) {
+    if (not bytes.empty()) {
+      os.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    }
+
+    return os;
+  }
+
+  template <std::size_t N>
+    requires requires(Stream_T& os, const gathered_datagram<N>& datagram) { os.send(datagram.pieces); }
+  friend Stream_T& operator<<(Stream_T& os, const gathered_datagram<N>& datagram) {
+    os.send(datagram.pieces);
+    return os;
+  }
+
+  template <typename Data_T, async_send_fn_like Callback_T>
+    requires requires(Stream_T& os, std::pair<Data_T, Callback_T>&& data_and_callback) {
+               os->async_write(std::move(data_and_callback));
+             }
+  friend Stream_T& operator<<(Stream_T& os, std::pair<Data_T, Callback_T>&& data_and_callback) {
+    // Anything that's still buffered in the stream was written first, so it's sent first.
+    os.flush();
+    if (not os->async_write(std::move(data_and_callback))) {
+      os.setstate(std::ios::failbit);
+    }
+
+    return os;
+  }
+};
+
+// Likewise for the datagram istreams. Anything that the stream's source can start an async read with (a callback, or
+// whatever dispatch_to() or receive_ring() wrap one in, for the streams that support them) starts one.
+template <typename Stream_T>
+class datagram_istream {
+ public:
+  // The tap is called on whichever thread is doing the receiving, so set it before starting to read.
+  void set_receive_tap(receive_tap tap)
+    requires requires(Stream_T& is, receive_tap tap) { is->set_receive_tap(std::move(tap)); }
+  {
+    _self()->set_receive_tap(std::move(tap));
+  }
+
+  std::shared_ptr<latency_histogram> enable_latency_probe()
+    requires requires(Stream_T& is) { is->enable_latency_probe(); }
+  {
+    return _self()->enable_latency_probe();
+  }
+
+  // These read a single datagram straight from the socket, bypassing the stream's buffer, and never block for longer than
+  // they're asked to.
+  template <contiguous_byte_range_like Range_T>
+    requires requires(Stream_T& is, char* s, std::size_t n) { is->try_read(s, n); }
+  [[nodiscard]] recv_result try_read(Range_T&& bytes) {
+    return _self()->try_read(_data_of(bytes), _size_of(bytes));
+  }
+
+  template <contiguous_byte_range_like Range_T, typename Rep_T, typename Period_T>
+    requires requires(Stream_T& is, char* s, std::size_t n, std::chrono::duration<Rep_T, Period_T> timeout) {
+               is->read_for(s, n, timeout);
+             }
+  [[nodiscard]] recv_result read_for(Range_T&& bytes, std::chrono::duration<Rep_T, Period_T> timeout) {
+    return _self()->read_for(_data_of(bytes), _size_of(bytes), timeout);
+  }
+
+  template <contiguous_byte_range_like Range_T>
+    requires requires(Stream_T& is, char* s, std::size_t n, std::chrono::steady_clock::time_point deadline) {
+               is->read_until(s, n, deadline);
+             }
+  [[nodiscard]] recv_result read_until(Range_T&& bytes, std::chrono::steady_clock::time_point deadline) {
+    return _self()->read_until(_data_of(bytes), _size_of(bytes), deadline);
+  }
+
+  // Both cancels clear any error that previously occurred on the stream, since someone may have tried to synchronously read
+  // the stream while the async read was in progress. This will have put the stream in an error state and it will not be
+  // possible to read from the stream until that error is cleared.
+  void cancel_async_recv()
+    requires requires(Stream_T& is) { is->cancel_async_read(); }
+  {
+    _self()->cancel_async_read();
+    _self().clear();
+  }
+
+  void cancel_sync_recv()
+    requires requires(Stream_T& is) { is->cancel_sync_read(); }
+  {
+    _self()->cancel_sync_read();
+    _self().clear();
+  }
+
+ private:
+  [[nodiscard]] Stream_T& _self() noexcept { return static_cast<Stream_T&>(*this); }
+
+  template <typename Range_T>
+  [[nodiscard]] static char* _data_of(Range_T& bytes) {
+    return reinterpret_cast<char*>(bytes.data());
+  }
+
+  template <typename Range_T>
+  [[nodiscard]] static std::size_t _size_of(const Range_T& bytes) {
+    return bytes.size() * sizeof(typename std::decay_t<Range_T>::value_type);
+  }
+
+  template <contiguous_byte_range_like Range_T>
+    requires(not std::is_same_v<std::string, std::decay_t<Range_T>>)
+  friend Stream_T& operator>>(Stream_T& is, Range_T&& bytes) {
+    if (not bytes.empty()) {
+      is.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    }
+
+    return is;
+  }
+
+  template <typename Reader_T>
+    requires requires(Stream_T& is, Reader_T&& reader) { is->async_read(std::forward<Reader_T>(reader)); }
+  friend Stream_T& operator>>(Stream_T& is, Reader_T&& reader) {
+    if (not is->async_read(std::forward<Reader_T>(reader))) {
+      is.setstate(std::ios::failbit);
+    }
+
+    return is;
+  }
+};
 
 }  // namespace nsl::udp
@@ -0,0 +1,177 @@
+#include "framework.h"
+
+#include <nsl/udp/capture.hpp>
+#include <nsl/udp/istream.hpp>
+#include <nsl/udp/ostream.hpp>
+#include <nsl/udp/types.hpp>
+
+#include "test/io_runner.hpp"
+#include "test/udp_receiver.hpp"
+#include "test/waiting.hpp"
+
+#include <boost/asio.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <fmt/format.h>
+#include <wite/core/scope.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+using namespace nsl;
+using namespace std::chrono_literals;
+
+TEST_CASE("capturing and replaying datagrams") {
+  auto io                  = boost::asio::io_context{};
+  constexpr auto recv_port = udp::port_number{40400};
+  constexpr auto sink_port = udp::port_number{40401};
+
+  const auto capture_path = std::filesystem::temp_directory_path() / "nsl_capture_test.nslcap";
+
+  // Declared before anything that maps the file, so that they've all let go of it by the time it's removed.
+  const auto remove_capture = wite::scope_exit{[&capture_path]() {
+    auto ec = std::error_code{};
+    std::filesystem::remove(capture_path, ec);
+  }};
+
+  const auto sent = std::vector<std::string>{"first", "", "third datagram", std::string(3000, 'x')};
+  {
+    // Start small, so that the file has to grow while capturing.
+    auto writer = udp::capture_writer{capture_path, 64};
+
+    auto udp_in = udp::istream{io, recv_port};
+    writer.attach(udp_in);
+
+    auto recv_count = std::atomic_size_t{0};
+    udp_in >> [&](auto&&, size_t) { ++recv_count; };
+
+    auto _ = test::io_runner{io};
+
+    auto udp_out = udp::ostream{io, "localhost", recv_port};
+    for (const auto& datagram : sent) {
+      std::ignore = udp_out->write(datagram.data(), static_cast<std::streamsize>(datagram.size()));
+      std::this_thread::sleep_for(10ms);
+    }
+
+    REQUIRE(test::wait_for([&]() { return recv_count.load() == sent.size(); }, 3s));
+    REQUIRE(sent.size() == writer.size());
+
+    udp_in.cancel_async_recv();
+  }
+
+  io.restart();
+
+  auto capture = udp::capture_reader{capture_path};
+
+  SECTION("the capture holds every datagram, in order, with increasing timestamps") {
+    auto records = std::vector<udp::capture_record>(capture.begin(), capture.end());
+    REQUIRE(sent.size() == records.size());
+
+    for (auto i = 0u; i < sent.size(); ++i) {
+      REQUIRE(sent[i] == std::string(records[i].data.begin(), records[i].data.end()));
+
+      if (i > 0) {
+        REQUIRE(records[i].timestamp > records[i - 1].timestamp);
+      }
+    }
+  }
+
+  SECTION("the capture can be replayed") {
+    auto recv_mtx = std::mutex{};
+    auto received = std::vector<std::string>{};
+
+    auto receiver = test::udp::receiver{io, sink_port, [&](auto& is, size_t n) {
+                                          auto str = std::string(n, '\0');
+                                          is.read(str.data(), n);
+
+                                          auto _ = std::unique_lock{recv_mtx};
+                                          received.push_back(std::move(str));
+                                        }};
+    auto _ = test::io_runner{io};
+
+    auto udp_out = udp::ostream{io, "localhost", sink_port};
+
+    const auto timing = GENERATE(udp::replay_timing::original, udp::replay_timing::as_fast_as_possible);
+
+    const auto start = std::chrono::steady_clock::now();
+    REQUIRE(sent.size() == udp::replay(capture, udp_out, timing));
+    const auto duration = std::chrono::steady_clock::now() - start;
+
+    if (timing == udp::replay_timing::original) {
+      REQUIRE(duration >= 30ms);
+    }
+
+    REQUIRE(test::wait_for(
+        [&]() {
+          auto _ = std::unique_lock{recv_mtx};
+          return received.size() == sent.size();
+        },
+        3s));
+
+    REQUIRE(sent == received);
+  }
+
+  SECTION("a file that isn't a capture is rejected") {
+    const auto bad_path = std::filesystem::temp_directory_path() / "nsl_not_a_capture.nslcap";
+    std::ofstream{bad_path} << "this is not a capture file";
+
+    REQUIRE_THROWS_AS(udp::capture_reader{bad_path}, std::runtime_error);
+
+    std::filesystem::remove(bad_path);
+  }
+}
+
+TEST_CASE("reading a capture that's still being written") {
+  const auto capture_path   = std::filesystem::temp_directory_path() / "nsl_open_capture_test.nslcap";
+  const auto remove_capture = wite::scope_exit{[&capture_path]() {
+    auto ec = std::error_code{};
+    std::filesystem::remove(capture_path, ec);
+  }};
+
+  // The file is much bigger than what's been written to it, as it would be if the writer's process had died.
+  auto writer = udp::capture_writer{capture_path, 4096};
+
+  SECTION("there's nothing in it before anything is written") {
+    auto capture = udp::capture_reader{capture_path};
+    REQUIRE(capture.begin() == capture.end());
+  }
+
+  SECTION("it stops at the last record written, rather than reading the space after it") {
+    writer.append(std::string_view{"one"});
+    writer.append(std::string_view{"two"});
+
+    auto capture = udp::capture_reader{capture_path};
+    auto records = std::vector<udp::capture_record>(capture.begin(), capture.end());
+
+    REQUIRE(2 == records.size());
+    REQUIRE("two" == std::string(records[1].data.begin(), records[1].data.end()));
+  }
+
+  SECTION("a writer whose file has gone is still closed") {
+    std::filesystem::remove(capture_path);
+
+    SECTION("and close() says that the file couldn't be trimmed") {
+      REQUIRE_THROWS_AS(writer.close(), std::filesystem::filesystem_error);
+      REQUIRE_NOTHROW(writer.close());
+    }
+
+    SECTION("and being destroyed doesn't throw") {
+      {
+        auto other_path = std::filesystem::temp_directory_path() / "nsl_vanishing_capture_test.nslcap";
+        auto other      = udp::capture_writer{other_path, 4096};
+        other.append(std::string_view{"one"});
+        std::filesystem::remove(other_path);
+      }
+
+      SUCCEED("the writer was destroyed");
+    }
+  }
+}
@@ -0,0 +1,249 @@
+#include "framework.h"
+
+#include <nsl/udp/coalesce.hpp>
+#include <nsl/udp/istream.hpp>
+#include <nsl/udp/ostream.hpp>
+#include <nsl/udp/types.hpp>
+
+#include "test/io_runner.hpp"
+#include "test/waiting.hpp"
+
+#include <boost/asio.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <mutex>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace nsl;
+using namespace std::chrono_literals;
+
+TEST_CASE("UDP ostream coalescing tests") {
+  auto io                  = boost::asio::io_context{};
+  constexpr auto test_port = udp::port_number{41200};
+
+  auto udp_in  = udp::istream{io, test_port};
+  auto udp_out = udp::ostream{io, "localhost", test_port};
+
+  auto mtx            = std::mutex{};
+  auto messages       = std::vector<std::string>{};
+  auto datagram_count = std::atomic_int{0};
+
+  auto handle_message = [&](auto&& is, size_t n) {
+    auto str = std::string(n, '\0');
+    is.read(str.data(), n);
+
+    auto _ = std::unique_lock{mtx};
+    messages.push_back(std::move(str));
+  };
+
+  auto message_count = [&]() {
+    auto _ = std::unique_lock{mtx};
+    return messages.size();
+  };
+
+  // Counts the datagrams on the way in, before they're split up into messages.
+  udp_in.set_receive_tap([&](std::span<const char>) { ++datagram_count; });
+
+  auto work = boost::asio::make_work_guard(io);
+  auto _    = test::io_runner{io};
+
+  SECTION("several small messages are packed into one datagram, and delivered separately") {
+    udp_out.enable_coalescing({.max_datagram_size = 1400, .flush_after = 50ms});
+    udp_in >> udp::deframed(handle_message);
+
+    for (auto i = 0; i < 10; ++i) {
+      udp_out << "message " << i << udp::flush;
+    }
+
+    REQUIRE(test::wait_for([&]() { return message_count() == 10; }, 2s));
+    REQUIRE(1 == datagram_count.load());
+
+    auto _ = std::unique_lock{mtx};
+    for (auto i = 0; i < 10; ++i) {
+      REQUIRE("message " + std::to_string(i) == messages[i]);
+    }
+  }
+
+  SECTION("a datagram is sent as soon as the next message won't fit in it") {
+    // Each message takes 2 + 8 bytes, so 3 of them fit in 32 bytes.
+    udp_out.enable_coalescing({.max_datagram_size = 32, .flush_after = 10s});
+    udp_in >> udp::deframed(handle_message);
+
+    for (auto i = 0; i < 6; ++i) {
+      udp_out << "12345678" << udp::flush;
+    }
+
+    REQUIRE(test::wait_for([&]() { return message_count() == 3; }, 2s));
+    REQUIRE(1 == datagram_count.load());
+
+    udp_out.flush_coalesced();
+
+    REQUIRE(test::wait_for([&]() { return message_count() == 6; }, 2s));
+    REQUIRE(2 == datagram_count.load());
+  }
+
+  SECTION("a message that's too big for a datagram on its own is sent by itself") {
+    udp_out.enable_coalescing({.max_datagram_size = 16, .flush_after = 10s});
+    udp_in >> udp::deframed(handle_message);
+
+    const auto big = std::string(100, 'x');
+    udp_out << big << udp::flush;
+
+    REQUIRE(test::wait_for([&]() { return message_count() == 1; }, 2s));
+
+    auto _ = std::unique_lock{mtx};
+    REQUIRE(big == messages.front());
+  }
+
+  SECTION("messages waiting to be coalesced are sent before a later async write, which is framed too") {
+    udp_out.enable_coalescing({.max_datagram_size = 1400, .flush_after = 10s});
+    udp_in >> udp::deframed(handle_message);
+
+    udp_out << "a" << udp::flush;
+    udp_out << "b" << udp::flush;
+
+    auto sent = std::promise<void>{};
+    udp_out << std::pair{std::string{"async"}, [&sent](size_t) { sent.set_value(); }};
+    REQUIRE(std::future_status::ready == sent.get_future().wait_for(2s));
+
+    REQUIRE(test::wait_for([&]() { return message_count() == 3; }, 2s));
+    REQUIRE(2 == datagram_count.load());
+
+    auto _ = std::unique_lock{mtx};
+    REQUIRE(std::vector<std::string>{"a", "b", "async"} == messages);
+  }
+
+  SECTION("text that's still in the stream's buffer is sent before a later async write") {
+    udp_out.enable_coalescing({.max_datagram_size = 1400, .flush_after = 10s});
+    udp_in >> udp::deframed(handle_message);
+
+    udp_out << "buffered";
+
+    auto sent = std::promise<void>{};
+    udp_out << std::pair{std::string{"async"}, [&sent](size_t) { sent.set_value(); }};
+    REQUIRE(std::future_status::ready == sent.get_future().wait_for(2s));
+
+    REQUIRE(test::wait_for([&]() { return message_count() == 2; }, 2s));
+
+    auto _ = std::unique_lock{mtx};
+    REQUIRE(std::vector<std::string>{"buffered", "async"} == messages);
+  }
+
+  SECTION("committed and gathered datagrams are framed while coalescing is on") {
+    udp_out.enable_coalescing({.max_datagram_size = 1400, .flush_after = 10s});
+    udp_in >> udp::deframed(handle_message);
+
+    const auto buf = udp_out.prepare(9);
+    std::memcpy(buf.data(), "committed", 9);
+    udp_out.commit(9);
+
+    REQUIRE(std::string_view{"gathered"}.size() == udp_out.send(std::string_view{"gath"}, std::string_view{"ered"}));
+
+    REQUIRE(test::wait_for([&]() { return message_count() == 2; }, 2s));
+
+    auto _ = std::unique_lock{mtx};
+    REQUIRE(std::vector<std::string>{"committed", "gathered"} == messages);
+  }
+
+  SECTION("the flush timer sends a partly filled datagram") {
+    udp_out.enable_coalescing({.max_datagram_size = 1400, .flush_after = 1ms});
+    udp_in >> udp::deframed(handle_message);
+
+    udp_out << "lonely" << udp::flush;
+
+    REQUIRE(test::wait_for([&]() { return message_count() == 1; }, 2s));
+  }
+
+  udp_in.cancel_async_recv();
+}
+
+TEST_CASE("deframing a coalesced datagram") {
+  auto messages = std::vector<std::string>{};
+  auto deframe  = udp::deframed([&](auto&& is, size_t n) {
+    auto str = std::string(n, '\0');
+    is.read(str.data(), n);
+    messages.push_back(std::move(str));
+  });
+
+  auto framed = udp::detail::coalescer{{.max_datagram_size = 64}};
+  framed.append("one", 3);
+  framed.append("", 0);
+  framed.append("three", 5);
+
+  SECTION("each message's length goes in front of it, big-endian") {
+    const auto datagram = framed.datagram();
+    REQUIRE(3 + 0 + 5 + 3 * 2 == datagram.size());
+    REQUIRE(std::string{'\0', '\3', 'o', 'n', 'e', '\0', '\0', '\0', '\5'} == std::string(datagram.data(), 9));
+  }
+
+  SECTION("every message is delivered, including empty ones") {
+    auto datagram = std::string(framed.datagram().data(), framed.datagram().size());
+    auto is       = std::istringstream{datagram};
+    deframe(is, datagram.size());
+
+    REQUIRE(std::vector<std::string>{"one", "", "three"} == messages);
+  }
+
+  SECTION("datagrams can be deframed on several threads at once") {
+    constexpr auto thread_count  = 4;
+    constexpr auto message_count = 1000;
+
+    auto mtx      = std::mutex{};
+    auto received = std::vector<std::string>{};
+    auto shared   = udp::deframed([&](auto&& is, size_t n) {
+      auto str = std::string(n, '\0');
+      is.read(str.data(), n);
+
+      auto _ = std::unique_lock{mtx};
+      received.push_back(std::move(str));
+    });
+
+    // Each thread has its own copy of the callback, as the workers of a dispatch_to() do, and its own datagram, whose
+    // messages are all the same so that a message that's been mixed up with another thread's is easy to spot.
+    auto threads = std::vector<std::thread>{};
+    for (auto t = 0; t < thread_count; ++t) {
+      threads.emplace_back([t, deframe = shared]() mutable {
+        auto coalesced = udp::detail::coalescer{{.max_datagram_size = 1400}};
+        const auto message = std::string(200, static_cast<char>('a' + t));
+        for (auto i = 0; i < 6; ++i) {
+          coalesced.append(message.data(), message.size());
+        }
+
+        const auto datagram = std::string(coalesced.datagram().data(), coalesced.datagram().size());
+        for (auto i = 0; i < message_count; ++i) {
+          auto is = std::istringstream{datagram};
+          deframe(is, datagram.size());
+        }
+      });
+    }
+
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    REQUIRE(thread_count * message_count * 6 == received.size());
+    REQUIRE(0 == std::count_if(received.begin(), received.end(), [](const auto& message) {
+              return message != std::string(200, message.empty() ? '\0' : message.front());
+            }));
+  }
+
+  SECTION("a message that's been cut short is dropped") {
+    auto datagram = std::string(framed.datagram().data(), framed.datagram().size() - 1);
+    auto is       = std::istringstream{datagram};
+    deframe(is, datagram.size());
+
+    REQUIRE(std::vector<std::string>{"one", ""} == messages);
+  }
+}
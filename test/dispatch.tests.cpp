@@ -0,0 +1,99 @@
+#include "framework.h"
+
+#include <nsl/udp/dispatch.hpp>
+#include <nsl/udp/istream.hpp>
+#include <nsl/udp/types.hpp>
+
+#include "test/io_runner.hpp"
+#include "test/waiting.hpp"
+
+#include <boost/asio.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <fmt/format.h>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace nsl;
+using namespace std::chrono_literals;
+
+TEST_CASE("dispatching async receive callbacks to a worker pool") {
+  auto io                  = boost::asio::io_context{};
+  constexpr auto test_port = udp::port_number{40200};
+
+  auto pool   = udp::worker_pool{4};
+  auto udp_in = udp::istream{io, test_port};
+
+  auto mtx           = std::mutex{};
+  auto received      = std::map<std::string, std::vector<int>>{};
+  auto callback_tids = std::set<std::thread::id>{};
+  auto recv_count    = std::atomic_int{0};
+
+  auto handle_datagram = [&](auto&& is, size_t n) {
+    auto str = std::string(n, '\0');
+    is.read(str.data(), n);
+
+    // Make the handler slow enough that several of them are in flight at once.
+    std::this_thread::sleep_for(1ms);
+
+    const auto sep = str.find(':');
+    {
+      auto _ = std::unique_lock{mtx};
+      received[str.substr(0, sep)].push_back(std::stoi(str.substr(sep + 1)));
+      callback_tids.insert(std::this_thread::get_id());
+    }
+
+    ++recv_count;
+  };
+
+  udp_in >> udp::dispatch_to(pool, handle_datagram);
+  REQUIRE_FALSE(udp_in.fail());
+
+  auto io_tid = std::thread::id{};
+  boost::asio::post(io, [&io_tid]() { io_tid = std::this_thread::get_id(); });
+
+  auto _ = test::io_runner{io};
+
+  constexpr auto sender_count         = 3;
+  constexpr auto datagrams_per_sender = 50;
+
+  auto resolver = boost::asio::ip::udp::resolver{io};
+  auto endpoint = resolver.resolve(boost::asio::ip::udp::v4(), "localhost", std::to_string(test_port)).begin()->endpoint();
+
+  auto senders = std::vector<boost::asio::ip::udp::socket>{};
+  for (auto s = 0; s < sender_count; ++s) {
+    senders.emplace_back(io, boost::asio::ip::udp::endpoint{boost::asio::ip::udp::v4(), 0});
+  }
+
+  for (auto i = 0; i < datagrams_per_sender; ++i) {
+    for (auto s = 0; s < sender_count; ++s) {
+      senders[s].send_to(boost::asio::buffer(fmt::format("{}:{}", s, i)), endpoint);
+    }
+  }
+
+  REQUIRE(test::wait_for([&]() { return recv_count.load() == sender_count * datagrams_per_sender; }, 5s));
+
+  SECTION("datagrams from each sender are handled in the order that they were sent") {
+    auto _ = std::unique_lock{mtx};
+    REQUIRE(sender_count == received.size());
+
+    for (const auto& [sender, sequence] : received) {
+      REQUIRE(datagrams_per_sender == sequence.size());
+      REQUIRE(std::is_sorted(sequence.begin(), sequence.end()));
+    }
+  }
+
+  SECTION("callbacks don't run on the io thread") {
+    auto _ = std::unique_lock{mtx};
+    REQUIRE(0 == callback_tids.count(io_tid));
+  }
+
+  udp_in.cancel_async_recv();
+  pool.join();
+}
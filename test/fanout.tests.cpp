@@ -0,0 +1,86 @@
+#include "framework.h"
+
+#include <nsl/udp/fanout.hpp>
+#include <nsl/udp/istream.hpp>
+#include <nsl/udp/types.hpp>
+
+#include <boost/asio.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace nsl;
+using namespace std::chrono_literals;
+
+TEST_CASE("UDP fan-out ostream tests") {
+  auto io                   = boost::asio::io_context{};
+  constexpr auto first_port = udp::port_number{41100};
+  constexpr auto sub_count  = 8;
+
+  auto subscribers = std::vector<std::unique_ptr<udp::istream>>{};
+  for (auto i = 0; i < sub_count; ++i) {
+    subscribers.push_back(std::make_unique<udp::istream>(io, static_cast<udp::port_number>(first_port + i)));
+  }
+
+  auto receive = [](udp::istream& in) -> std::optional<std::string> {
+    auto buf          = std::array<char, 256>{};
+    const auto result = in.read_for(buf, 500ms);
+    if (not result) {
+      return std::nullopt;
+    }
+
+    return std::string(buf.data(), result.size);
+  };
+
+  auto fanout = udp::fanout_ostream{io};
+  for (auto i = 0; i < sub_count; ++i) {
+    REQUIRE(fanout.add_subscriber("localhost", static_cast<udp::port_number>(first_port + i)));
+  }
+
+  REQUIRE(sub_count == fanout.subscriber_count());
+
+  SECTION("every subscriber gets each datagram") {
+    fanout << "update " << 1 << udp::flush;
+    fanout << "update " << 2 << udp::flush;
+
+    for (auto& sub : subscribers) {
+      REQUIRE("update 1" == receive(*sub));
+      REQUIRE("update 2" == receive(*sub));
+    }
+
+    REQUIRE(0 == fanout.failed_sends());
+  }
+
+  SECTION("adding a subscriber that's already there does nothing") {
+    REQUIRE_FALSE(fanout.add_subscriber("localhost", first_port));
+    REQUIRE(sub_count == fanout.subscriber_count());
+  }
+
+  SECTION("a removed subscriber stops getting datagrams, and the rest carry on") {
+    REQUIRE(fanout.remove_subscriber("localhost", first_port));
+    REQUIRE_FALSE(fanout.remove_subscriber("localhost", first_port));
+    REQUIRE(sub_count - 1 == fanout.subscriber_count());
+
+    fanout << "after removal" << udp::flush;
+
+    REQUIRE(std::nullopt == receive(*subscribers.front()));
+    for (auto i = 1; i < sub_count; ++i) {
+      REQUIRE("after removal" == receive(*subscribers[i]));
+    }
+  }
+
+  SECTION("byte ranges are sent as they are") {
+    const auto bytes = std::vector<std::uint8_t>{0x01, 0x02, 0x03};
+    fanout << bytes << udp::flush;
+
+    for (auto& sub : subscribers) {
+      REQUIRE(std::string{"\x01\x02\x03"} == receive(*sub));
+    }
+  }
+}
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <nsl/udp/types.hpp>
+
+#include <boost/asio.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace nsl::test::udp {
+
+struct impairments {
+  double drop_rate      = 0.0;
+  double duplicate_rate = 0.0;
+  double reorder_rate   = 0.0;                    // Chance that a datagram is held back and sent after the next one.
+  std::chrono::microseconds reorder_hold{20000};  // How long a held datagram waits for the next one before it's sent anyway.
+  std::chrono::microseconds delay{0};
+  std::chrono::microseconds jitter{0};  // Uniformly distributed extra delay, on top of the fixed delay.
+  std::size_t bytes_per_second = 0;     // Zero means no bandwidth cap.
+  std::uint64_t seed           = 0;
+};
+
+struct impairment_stats {
+  std::size_t received   = 0;
+  std::size_t dropped    = 0;
+  std::size_t duplicated = 0;
+  std::size_t reordered  = 0;
+  std::size_t forwarded  = 0;
+};
+
+// A UDP proxy that sits between an ostream and an istream on the same machine and forwards datagrams with some loss,
+// duplication, reordering, delay and bandwidth limiting applied. All the random decisions are made from a generator seeded
+// with impairments::seed, so a given sequence of datagrams is always impaired in the same way.
+class impairment_proxy {
+  using clock = std::chrono::steady_clock;
+
+  struct kernel {
+    kernel(boost::asio::io_context& io, ::nsl::udp::port_number listen_port, impairments imp)
+        : io{io}
+        , socket{io, boost::asio::ip::udp::endpoint{boost::asio::ip::udp::v4(), listen_port}}
+        , hold_timer{io}
+        , imp{imp}
+        , rng{imp.seed} {}
+
+    ~kernel() {
+      if (socket.is_open()) {
+        socket.close();
+      }
+    }
+
+    boost::asio::io_context& io;
+    boost::asio::ip::udp::socket socket;
+    boost::asio::steady_timer hold_timer;
+    boost::asio::ip::udp::endpoint target{};
+    boost::asio::ip::udp::endpoint sender{};
+    impairments imp;
+    std::mt19937_64 rng;
+    std::vector<char> recv_buf = std::vector<char>(65536);
+    std::shared_ptr<const std::vector<char>> held{};
+    clock::time_point link_free_at{};
+
+    std::atomic_size_t received{0};
+    std::atomic_size_t dropped{0};
+    std::atomic_size_t duplicated{0};
+    std::atomic_size_t reordered{0};
+    std::atomic_size_t forwarded{0};
+  };
+
+ public:
+  explicit impairment_proxy(boost::asio::io_context& io,
+                            ::nsl::udp::port_number listen_port,
+                            std::string target_host,
+                            ::nsl::udp::port_number target_port,
+                            impairments imp = impairments{})
+      : _kernel{std::make_shared<kernel>(io, listen_port, imp)} {
+    auto resolver   = boost::asio::ip::udp::resolver{io};
+    _kernel->target = resolver.resolve(boost::asio::ip::udp::v4(), target_host, std::to_string(target_port)).begin()->endpoint();
+
+    _receive(_kernel);
+  }
+
+  ~impairment_proxy() { stop(); }
+
+  // Sends the datagram that's being held back for reordering, if there is one, and closes the socket. The held datagram is
+  // looked after on the io_context, so this is done there too.
+  void stop() {
+    boost::asio::post(_kernel->io, [k = _kernel]() { _close(k); });
+  }
+
+  [[nodiscard]] ::nsl::udp::port_number listen_port() const { return _kernel->socket.local_endpoint().port(); }
+
+  [[nodiscard]] impairment_stats stats() const {
+    return {_kernel->received.load(),
+            _kernel->dropped.load(),
+            _kernel->duplicated.load(),
+            _kernel->reordered.load(),
+            _kernel->forwarded.load()};
+  }
+
+ private:
+  static void _receive(std::shared_ptr<kernel> k) {
+    auto& k_ref = *k;
+    k_ref.socket.async_receive_from(
+        boost::asio::buffer(k_ref.recv_buf), k_ref.sender, [k = std::move(k)](auto&& err, size_t n) {
+          if (err) {
+            return;
+          }
+
+          ++k->received;
+          _impair(k, std::make_shared<const std::vector<char>>(k->recv_buf.begin(), k->recv_buf.begin() + n));
+
+          _receive(k);
+        });
+  }
+
+  static void _impair(const std::shared_ptr<kernel>& k, std::shared_ptr<const std::vector<char>> datagram) {
+    auto chance = std::uniform_real_distribution<double>{0.0, 1.0};
+
+    if (chance(k->rng) < k->imp.drop_rate) {
+      ++k->dropped;
+      return;
+    }
+
+    const auto copies = chance(k->rng) < k->imp.duplicate_rate ? 2 : 1;
+    if (copies > 1) {
+      ++k->duplicated;
+    }
+
+    if (k->held) {
+      k->hold_timer.cancel();
+
+      for (auto i = 0; i < copies; ++i) {
+        _schedule(k, datagram);
+      }
+
+      _schedule(k, std::exchange(k->held, nullptr));
+      return;
+    }
+
+    if (chance(k->rng) < k->imp.reorder_rate) {
+      ++k->reordered;
+
+      // Duplicates of a held datagram go out ahead of it.
+      for (auto i = 1; i < copies; ++i) {
+        _schedule(k, datagram);
+      }
+
+      _hold(k, std::move(datagram));
+      return;
+    }
+
+    for (auto i = 0; i < copies; ++i) {
+      _schedule(k, datagram);
+    }
+  }
+
+  // If nothing arrives to overtake a held datagram, it's sent anyway once it's been held for reorder_hold. The timer's
+  // handler may already be queued when the next datagram cancels it, so it checks that it's still the same one being held.
+  static void _hold(const std::shared_ptr<kernel>& k, std::shared_ptr<const std::vector<char>> datagram) {
+    k->held = std::move(datagram);
+    k->hold_timer.expires_after(k->imp.reorder_hold);
+    k->hold_timer.async_wait([k, held = k->held](auto&& err) {
+      if (not err and k->held == held) {
+        _schedule(k, std::exchange(k->held, nullptr));
+      }
+    });
+  }
+
+  static void _schedule(const std::shared_ptr<kernel>& k, std::shared_ptr<const std::vector<char>> datagram) {
+    auto send_at = clock::now() + k->imp.delay;
+    if (k->imp.jitter.count() > 0) {
+      send_at += std::chrono::microseconds{
+          std::uniform_int_distribution<std::chrono::microseconds::rep>{0, k->imp.jitter.count()}(k->rng)};
+    }
+
+    if (k->imp.bytes_per_second > 0) {
+      const auto time_on_wire = std::chrono::duration<double>{static_cast<double>(datagram->size()) /
+                                                              static_cast<double>(k->imp.bytes_per_second)};
+
+      send_at         = std::max(send_at, k->link_free_at);
+      k->link_free_at = send_at + std::chrono::duration_cast<clock::duration>(time_on_wire);
+    }
+
+    if (send_at <= clock::now()) {
+      _send(k, std::move(datagram));
+      return;
+    }
+
+    auto timer = std::make_shared<boost::asio::steady_timer>(k->io, send_at);
+    timer->async_wait([k, timer, datagram = std::move(datagram)](auto&& err) mutable {
+      if (not err) {
+        _send(k, std::move(datagram));
+      }
+    });
+  }
+
+  static void _send(const std::shared_ptr<kernel>& k, std::shared_ptr<const std::vector<char>> datagram) {
+    auto& data = *datagram;
+    k->socket.async_send_to(boost::asio::buffer(data), k->target, [k, datagram = std::move(datagram)](auto&& err, size_t) {
+      if (not err) {
+        ++k->forwarded;
+      }
+    });
+  }
+
+  static void _close(const std::shared_ptr<kernel>& k) {
+    k->hold_timer.cancel();
+
+    auto ec = boost::system::error_code{};
+    if (k->held and k->socket.is_open()) {
+      k->socket.send_to(boost::asio::buffer(*std::exchange(k->held, nullptr)), k->target, 0, ec);
+      if (not ec) {
+        ++k->forwarded;
+      }
+    }
+
+    k->socket.close(ec);
+  }
+
+  std::shared_ptr<kernel> _kernel;
+};
+
+}  // namespace nsl::test::udp
@@ -0,0 +1,129 @@
+#include "framework.h"
+
+#include <nsl/udp/istream.hpp>
+#include <nsl/udp/ostream.hpp>
+#include <nsl/udp/types.hpp>
+
+#include "test/impairment_proxy.hpp"
+#include "test/io_runner.hpp"
+#include "test/waiting.hpp"
+
+#include <boost/asio.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace nsl;
+using namespace std::chrono_literals;
+
+namespace {
+
+// Sends the numbers [0, count) through a proxy with the given impairments and returns what came out of the other side, in
+// the order that it arrived.
+std::vector<int> send_through_proxy(test::udp::impairments imp,
+                                    int count,
+                                    std::chrono::milliseconds settle_time = 100ms,
+                                    test::udp::impairment_stats* stats   = nullptr) {
+  constexpr auto proxy_port = udp::port_number{40500};
+  constexpr auto recv_port  = udp::port_number{40501};
+
+  auto io = boost::asio::io_context{};
+
+  auto mtx      = std::mutex{};
+  auto received = std::vector<int>{};
+
+  auto udp_in = udp::istream{io, recv_port};
+  udp_in >> [&](auto&& is, size_t n) {
+    auto str = std::string(n, '\0');
+    is.read(str.data(), n);
+
+    auto _ = std::unique_lock{mtx};
+    received.push_back(std::stoi(str));
+  };
+
+  auto proxy = test::udp::impairment_proxy{io, proxy_port, "localhost", recv_port, imp};
+  auto _     = test::io_runner{io};
+
+  auto udp_out = udp::ostream{io, "localhost", proxy_port};
+  for (auto i = 0; i < count; ++i) {
+    udp_out << std::to_string(i) << udp::flush;
+  }
+
+  std::this_thread::sleep_for(settle_time);
+
+  if (stats) {
+    *stats = proxy.stats();
+  }
+
+  udp_in.cancel_async_recv();
+
+  auto lock = std::unique_lock{mtx};
+  return received;
+}
+
+[[nodiscard]] std::vector<int> iota(int count) {
+  auto out = std::vector<int>(count);
+  std::iota(out.begin(), out.end(), 0);
+  return out;
+}
+
+}  // namespace
+
+TEST_CASE("impairment proxy tests") {
+  SECTION("with no impairments, everything arrives in order") {
+    REQUIRE(iota(50) == send_through_proxy({}, 50));
+  }
+
+  SECTION("dropping everything means nothing arrives") {
+    auto stats = test::udp::impairment_stats{};
+    REQUIRE(send_through_proxy({.drop_rate = 1.0}, 20, 100ms, &stats).empty());
+    REQUIRE(20 == stats.received);
+    REQUIRE(20 == stats.dropped);
+  }
+
+  SECTION("loss is deterministic for a given seed") {
+    const auto imp   = test::udp::impairments{.drop_rate = 0.5, .seed = 12345};
+    const auto first = send_through_proxy(imp, 100);
+
+    REQUIRE(first.size() > 0);
+    REQUIRE(first.size() < 100);
+    REQUIRE(first == send_through_proxy(imp, 100));
+  }
+
+  SECTION("duplicated datagrams arrive twice") {
+    auto expected = std::vector<int>{};
+    for (auto i = 0; i < 10; ++i) {
+      expected.insert(expected.end(), {i, i});
+    }
+
+    REQUIRE(expected == send_through_proxy({.duplicate_rate = 1.0}, 10));
+  }
+
+  SECTION("reordered datagrams are sent after the one that follows them") {
+    REQUIRE(std::vector{1, 0, 3, 2, 5, 4} == send_through_proxy({.reorder_rate = 1.0}, 6));
+  }
+
+  SECTION("a reordered datagram that nothing follows is still sent") {
+    auto stats = test::udp::impairment_stats{};
+    REQUIRE(std::vector{1, 0, 2} == send_through_proxy({.reorder_rate = 1.0}, 3, 100ms, &stats));
+    REQUIRE(2 == stats.reordered);
+    REQUIRE(3 == stats.forwarded);
+  }
+
+  SECTION("delayed datagrams don't arrive until the delay has passed") {
+    REQUIRE(send_through_proxy({.delay = 200ms}, 5, 50ms).empty());
+    REQUIRE(iota(5) == send_through_proxy({.delay = 50ms}, 5, 200ms));
+  }
+
+  SECTION("the bandwidth cap limits how much gets through in a given time") {
+    // Each datagram is one or two bytes, so at 20 bytes/s only a handful can get through in the time allowed.
+    const auto received = send_through_proxy({.bytes_per_second = 20}, 50, 200ms);
+    REQUIRE(received.size() < 10);
+    REQUIRE(iota(static_cast<int>(received.size())) == received);
+  }
+}
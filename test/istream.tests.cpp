@@ -13,6 +13,7 @@
 #include <boost/asio.hpp>
 #include <fmt/format.h>
 
+#include <array>
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
@@ -21,6 +22,7 @@
 #include <iostream>
 #include <mutex>
 #include <random>
+#include <set>
 #include <sstream>
 #include <string_view>
 #include <thread>
@@ -224,3 +226,99 @@ TEST_CASE("UDP istream tests") {
     }
   }
 }
+
+TEST_CASE("UDP istream deadline tests") {
+  using namespace nsl;
+
+  auto io                  = boost::asio::io_context{};
+  constexpr auto test_port = udp::port_number{40800};
+
+  auto udp_in                   = udp::istream{io, test_port};
+  auto [out_socket, in_address] = get_connected_socket(io, test_port);
+
+  auto buffer = std::array<char, 64>{};
+
+  SECTION("try_read returns straight away when there's nothing to read") {
+    const auto result = udp_in.try_read(buffer);
+
+    REQUIRE(udp::recv_status::would_block == result.status);
+    REQUIRE_FALSE(result);
+  }
+
+  SECTION("read_for times out when nothing arrives") {
+    const auto start  = std::chrono::steady_clock::now();
+    const auto result = udp_in.read_for(buffer, 20ms);
+
+    REQUIRE(udp::recv_status::timed_out == result.status);
+    REQUIRE(std::chrono::steady_clock::now() - start >= 20ms);
+    REQUIRE(std::chrono::steady_clock::now() - start < 1s);
+  }
+
+  SECTION("read_until returns a datagram that arrives before the deadline") {
+    auto sent = test::running_async([&]() {
+      std::this_thread::sleep_for(10ms);
+      out_socket.send_to(boost::asio::buffer(std::string_view{"hello"}), in_address);
+    });
+
+    const auto result = udp_in.read_until(buffer, std::chrono::steady_clock::now() + 1s);
+
+    REQUIRE(result);
+    REQUIRE(5 == result.size);
+    REQUIRE("hello" == std::string_view{buffer.data(), result.size});
+
+    sent.get();
+  }
+
+  SECTION("try_read returns a datagram that's already waiting") {
+    out_socket.send_to(boost::asio::buffer(std::string_view{"waiting"}), in_address);
+
+    REQUIRE(test::wait_for([&]() { return udp_in.try_read(buffer).status != udp::recv_status::would_block; }, 1s));
+  }
+
+  SECTION("reads fail while an async read is in progress") {
+    udp_in >> [](auto&&, size_t) {};
+
+    auto _ = test::io_runner{io};
+
+    const auto result = udp_in.try_read(buffer);
+
+    REQUIRE(udp::recv_status::error == result.status);
+    REQUIRE(boost::asio::error::already_started == result.error);
+
+    udp_in.cancel_async_recv();
+  }
+}
+
+TEST_CASE("UDP istream shared socket tests") {
+  using namespace nsl;
+
+  auto io                  = boost::asio::io_context{};
+  constexpr auto test_port = udp::port_number{40810};
+
+  auto socket = std::make_shared<boost::asio::ip::udp::socket>(
+      io, boost::asio::ip::udp::endpoint{boost::asio::ip::udp::v4(), test_port});
+  auto first_in                 = udp::istream{io, socket};
+  auto second_in                = udp::istream{io, socket};
+  auto [out_socket, in_address] = get_connected_socket(io, test_port);
+
+  SECTION("a blocking read that another reader beats to the datagram goes back to waiting") {
+    const auto read_one = [](udp::istream& udp_in) {
+      auto buffer = std::array<char, 5>{};
+      udp_in >> buffer;
+      return udp_in.good() ? std::string{buffer.data(), buffer.size()} : std::string{};
+    };
+
+    auto first  = test::running_async([&]() { return read_one(first_in); });
+    auto second = test::running_async([&]() { return read_one(second_in); });
+
+    // Both readers are woken by the first datagram, but only one of them gets it. The other has to wait for the second.
+    std::this_thread::sleep_for(50ms);
+    out_socket.send_to(boost::asio::buffer(std::string_view{"first"}), in_address);
+    std::this_thread::sleep_for(50ms);
+    out_socket.send_to(boost::asio::buffer(std::string_view{"again"}), in_address);
+
+    REQUIRE(std::future_status::ready == first.wait_for(1s));
+    REQUIRE(std::future_status::ready == second.wait_for(1s));
+    REQUIRE(std::set<std::string>{"first", "again"} == std::set{first.get(), second.get()});
+  }
+}
@@ -0,0 +1,259 @@
+#include "framework.h"
+
+#include <nsl/local/stream.hpp>
+
+#include "test/io_runner.hpp"
+#include "test/waiting.hpp"
+
+#include <boost/asio.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using nlohmann::json;
+using namespace nsl;
+using namespace std::chrono_literals;
+
+TEST_CASE("reading and writing to local datagram streams") {
+  auto io = boost::asio::io_context{};
+
+  const auto path = (std::filesystem::temp_directory_path() / "nsl_local_stream_tests.sock").string();
+
+  SECTION("blocking streams") {
+    auto local_in  = local::istream{io, path};
+    auto local_out = local::ostream{io, path};
+
+    SECTION("writing and reading JSON") {
+      auto sent_json = json::parse(R"({"bool_field": true, "int_field": 12345, "string_field": "ahoy there!"})");
+
+      auto recv_data = test::running_async([&]() {
+        auto recv_json = json{};
+        local_in >> recv_json;
+        return recv_json;
+      });
+
+      local_out << sent_json << std::endl;
+
+      REQUIRE(sent_json == recv_data.get());
+    }
+
+    SECTION("writing and reading bytes") {
+      auto sent_bytes = std::vector<std::byte>(1024);
+      for (auto i = 0u; i < sent_bytes.size(); ++i) {
+        sent_bytes[i] = static_cast<std::byte>(i & 0xFF);
+      }
+
+      local_out << sent_bytes << local::flush;
+
+      auto recv_bytes = std::vector<std::byte>(sent_bytes.size());
+      local_in >> recv_bytes;
+
+      REQUIRE(sent_bytes == recv_bytes);
+    }
+  }
+
+  SECTION("the rest of the udp streams' API") {
+    auto local_in  = local::istream{io, path};
+    auto local_out = local::ostream{io, path};
+
+    auto buf = std::vector<char>(64);
+
+    SECTION("reads that don't wait for longer than they're told to") {
+      REQUIRE(local::recv_status::would_block == local_in.try_read(buf).status);
+      REQUIRE(local::recv_status::timed_out == local_in.read_for(buf, 10ms).status);
+
+      local_out << "datagram" << local::flush;
+
+      const auto result = local_in.read_until(buf, std::chrono::steady_clock::now() + 1s);
+      REQUIRE(result);
+      REQUIRE("datagram" == std::string_view{buf.data(), result.size});
+    }
+
+    SECTION("building a datagram in place, and sending one from pieces") {
+      constexpr auto message = std::string_view{"built in place"};
+
+      auto room = local_out.prepare(buf.size());
+      std::copy(message.begin(), message.end(), room.begin());
+      local_out.commit(message.size());
+
+      local_out.send(std::string_view{"header"}, std::string_view{"payload"});
+
+      auto result = local_in.read_for(buf, 1s);
+      REQUIRE(result);
+      REQUIRE(message == std::string_view{buf.data(), result.size});
+
+      result = local_in.read_for(buf, 1s);
+      REQUIRE(result);
+      REQUIRE("headerpayload" == std::string_view{buf.data(), result.size});
+    }
+
+    SECTION("sequenced and coalesced datagrams") {
+      local_out.enable_sequencing();
+      local_out.enable_coalescing({.max_datagram_size = 64, .flush_after = 10s});
+
+      local_out << "one" << local::flush;
+      local_out << "two" << local::flush;
+      local_out.flush_coalesced();
+
+      // An 8-byte sequence number, and then each message after its 2-byte length.
+      const auto result = local_in.read_for(buf, 1s);
+      REQUIRE(result);
+      REQUIRE(8 + 2 * (2 + 3) == result.size);
+      REQUIRE("one" == std::string_view{buf.data() + 10, 3});
+      REQUIRE("two" == std::string_view{buf.data() + 15, 3});
+    }
+  }
+
+  SECTION("a leftover socket file is replaced on bind, and removed afterwards") {
+    {
+      // Closing a socket doesn't remove its file, so this leaves one behind, as a process that died would.
+      auto leftover = boost::asio::local::datagram_protocol::socket{io, boost::asio::local::datagram_protocol::endpoint{path}};
+    }
+    REQUIRE(std::filesystem::is_socket(path));
+
+    {
+      auto local_in = local::istream{io, path};
+      REQUIRE(std::filesystem::is_socket(path));
+    }
+
+    REQUIRE_FALSE(std::filesystem::exists(path));
+  }
+
+  SECTION("a file that isn't a socket is left alone, and the bind fails") {
+    std::ofstream{path} << "not a socket";
+
+    REQUIRE_THROWS_AS(local::istream(io, path), boost::system::system_error);
+    REQUIRE(std::filesystem::is_regular_file(path));
+
+    std::filesystem::remove(path);
+  }
+
+  SECTION("non-blocking streams in the abstract namespace") {
+    const auto name = local::abstract_path("nsl_local_stream_tests");
+
+    auto mtx      = std::mutex{};
+    auto received = std::vector<std::string>{};
+
+    auto local_in = local::istream{io, name};
+    local_in >> [&](auto&& is, size_t n) {
+      auto str = std::string(n, '\0');
+      is.read(str.data(), n);
+
+      auto _ = std::unique_lock{mtx};
+      received.push_back(std::move(str));
+    };
+
+    auto _ = test::io_runner{io};
+
+    auto local_out = local::ostream{io, name};
+
+    auto sent_count = std::atomic_size_t{0};
+    auto sent       = std::vector<std::string>{};
+    for (auto i = 0; i < 100; ++i) {
+      sent.push_back(fmt::format("datagram number {}", i));
+      local_out << std::pair{sent.back(), [&](size_t) { ++sent_count; }};
+    }
+
+    REQUIRE(test::wait_for([&]() { return sent_count.load() == sent.size(); }, 3s));
+    REQUIRE(test::wait_for(
+        [&]() {
+          auto _ = std::unique_lock{mtx};
+          return received.size() == sent.size();
+        },
+        3s));
+
+    // Unlike UDP, datagrams on a local socket aren't lost or reordered.
+    REQUIRE(sent == received);
+
+    local_in.cancel_async_recv();
+  }
+
+  SECTION("IO stream") {
+    const auto client_path = (std::filesystem::temp_directory_path() / "nsl_local_client.sock").string();
+    const auto server_path = (std::filesystem::temp_directory_path() / "nsl_local_server.sock").string();
+
+    auto request  = json::parse(R"({"bool_field": true, "int_field": 12345, "string_field": "ahoy there!"})");
+    auto response = json{};
+
+    auto client     = local::stream{io, client_path, server_path};
+    auto server_in  = local::istream{io, server_path};
+    auto server_out = local::ostream{io, client_path};
+
+    auto mtx        = std::mutex{};
+    auto lock       = std::unique_lock{mtx};
+    auto data_ready = std::condition_variable{};
+
+    client >> [&](auto&& is, size_t n) {
+      auto str = std::string(n, '\0');
+      is.read(str.data(), n);
+      {
+        auto _   = std::unique_lock{mtx};
+        response = json::parse(str);
+      }
+      data_ready.notify_all();
+    };
+
+    auto _ = test::io_runner{io};
+
+    auto served = test::running_async([&]() {
+      auto req = json{};
+      server_in >> req;
+      server_out << (req == request ? json{{"result", 200}} : json{{"result", 400}}) << local::flush;
+    });
+
+    client << request << std::endl;
+
+    REQUIRE(data_ready.wait_for(lock, 3s, [&]() { return not response.is_null(); }));
+    REQUIRE(json{{"result", 200}} == response);
+
+    served.get();
+    client.cancel_async_recv();
+  }
+
+  SECTION("cancelling a stream's receive doesn't abort its queued sends") {
+    const auto client_path = (std::filesystem::temp_directory_path() / "nsl_local_cancel_client.sock").string();
+    const auto server_path = (std::filesystem::temp_directory_path() / "nsl_local_cancel_server.sock").string();
+
+    auto client    = local::stream{io, client_path, server_path};
+    auto server_in = local::istream{io, server_path};
+
+    client >> [](auto&&, size_t) {};
+
+    auto _ = test::io_runner{io};
+
+    // The server isn't reading yet, so its queue fills up and the rest of the client's sends are left waiting.
+    constexpr auto count = std::size_t{1000};
+    const auto datagram  = std::string(1024, 'x');
+
+    auto sent   = std::atomic_size_t{0};
+    auto failed = std::atomic_size_t{0};
+    for (auto i = std::size_t{0}; i < count; ++i) {
+      client << std::pair{datagram, [&](const boost::system::error_code& ec, size_t) { ++(ec ? failed : sent); }};
+    }
+
+    REQUIRE_FALSE(test::wait_for([&]() { return sent.load() == count; }, 100ms));
+
+    client.cancel_async_recv();
+
+    auto buf      = std::vector<char>(datagram.size());
+    auto received = std::size_t{0};
+    while (received < count and server_in->read_for(buf.data(), buf.size(), 1s)) {
+      ++received;
+    }
+
+    REQUIRE(count == received);
+    REQUIRE(test::wait_for([&]() { return sent.load() == count; }, 1s));
+    REQUIRE(0 == failed.load());
+  }
+}
@@ -0,0 +1,169 @@
+#include "framework.h"
+
+#include <nsl/udp/istream.hpp>
+#include <nsl/udp/mpsc.hpp>
+#include <nsl/udp/sequenced.hpp>
+#include <nsl/udp/types.hpp>
+
+#include "test/io_runner.hpp"
+#include "test/waiting.hpp"
+
+#include <boost/asio.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace nsl;
+using namespace std::chrono_literals;
+
+TEST_CASE("multi-producer UDP sender tests") {
+  auto io                  = boost::asio::io_context{};
+  constexpr auto test_port = udp::port_number{41300};
+
+  auto udp_in = udp::istream{io, test_port};
+
+  auto mtx        = std::mutex{};
+  auto received   = std::map<std::string, std::vector<int>>{};
+  auto recv_count = std::atomic_int{0};
+
+  udp_in >> [&](auto&& is, size_t n) {
+    auto str = std::string(n, '\0');
+    is.read(str.data(), n);
+
+    const auto sep = str.find(':');
+    {
+      auto _ = std::unique_lock{mtx};
+      received[str.substr(0, sep)].push_back(std::stoi(str.substr(sep + 1)));
+    }
+
+    ++recv_count;
+  };
+
+  auto work = boost::asio::make_work_guard(io);
+  auto _    = test::io_runner{io};
+
+  auto sender = udp::mpsc_sender{io, "localhost", test_port, {.send_batch = 8}};
+
+  SECTION("datagrams from several threads all arrive, each thread's in the order that it sent them") {
+    constexpr auto thread_count         = 4;
+    constexpr auto datagrams_per_thread = 50;
+
+    auto producers = std::vector<std::thread>{};
+    for (auto t = 0; t < thread_count; ++t) {
+      producers.emplace_back([&sender, t]() {
+        auto out = sender.make_producer();
+        for (auto i = 0; i < datagrams_per_thread; ++i) {
+          out << t << ":" << i << udp::flush;
+
+          // Don't overrun the receiver's socket buffer.
+          std::this_thread::sleep_for(100us);
+        }
+      });
+    }
+
+    for (auto& producer : producers) {
+      producer.join();
+    }
+
+    REQUIRE(test::wait_for([&]() { return recv_count.load() == thread_count * datagrams_per_thread; }, 5s));
+
+    auto _ = std::unique_lock{mtx};
+    REQUIRE(thread_count == received.size());
+    for (const auto& [producer, sequence] : received) {
+      REQUIRE(datagrams_per_thread == sequence.size());
+      REQUIRE(std::is_sorted(sequence.begin(), sequence.end()));
+    }
+
+    REQUIRE(0 == sender.failed_sends());
+  }
+
+  SECTION("a burst from several threads at once all arrives, without anything being sent after it") {
+    constexpr auto thread_count = 4;
+    constexpr auto burst_count  = 200;
+
+    for (auto burst = 0; burst < burst_count; ++burst) {
+      auto start     = std::atomic_bool{false};
+      auto producers = std::vector<std::thread>{};
+      for (auto t = 0; t < thread_count; ++t) {
+        producers.emplace_back([&sender, &start, t, burst]() {
+          while (not start.load()) {
+            std::this_thread::yield();
+          }
+
+          sender.make_producer() << t << ":" << burst << udp::flush;
+        });
+      }
+
+      start = true;
+      for (auto& producer : producers) {
+        producer.join();
+      }
+
+      // Nothing else is pushed until every datagram in this burst has arrived, so a lost wakeup leaves some of them stuck.
+      REQUIRE(test::wait_for([&]() { return recv_count.load() == thread_count * (burst + 1); }, 2s));
+    }
+
+    REQUIRE(0 == sender.failed_sends());
+  }
+
+  SECTION("raw bytes can be sent without a producer stream") {
+    const auto datagram = std::string{"raw:7"};
+    sender.send(datagram);
+
+    REQUIRE(test::wait_for([&]() { return recv_count.load() == 1; }, 2s));
+
+    auto _ = std::unique_lock{mtx};
+    REQUIRE(std::vector<int>{7} == received["raw"]);
+  }
+
+  udp_in.cancel_async_recv();
+}
+
+TEST_CASE("multi-producer UDP sender sharing an ostream's sink") {
+  auto io                  = boost::asio::io_context{};
+  constexpr auto test_port = udp::port_number{41310};
+
+  auto udp_in  = udp::istream{io, test_port};
+  auto udp_out = udp::ostream{io, "localhost", test_port};
+  udp_out.enable_sequencing();
+
+  auto mtx      = std::mutex{};
+  auto received = std::vector<std::string>{};
+  udp_in >> udp::sequenced([&](auto&& is, size_t n) {
+    auto str = std::string(n, '\0');
+    is.read(str.data(), n);
+
+    auto _ = std::unique_lock{mtx};
+    received.push_back(std::move(str));
+  });
+
+  auto work = boost::asio::make_work_guard(io);
+  auto _    = test::io_runner{io};
+
+  auto sender = udp::mpsc_sender{io, udp_out};
+
+  SECTION("datagrams from the sender are numbered along with the ostream's own") {
+    udp_out << "from the ostream" << udp::flush;
+    sender.send(std::string{"from the sender"});
+
+    REQUIRE(test::wait_for(
+        [&]() {
+          auto _ = std::unique_lock{mtx};
+          return received.size() == 2;
+        },
+        2s));
+
+    auto _ = std::unique_lock{mtx};
+    REQUIRE(std::vector<std::string>{"from the ostream", "from the sender"} == received);
+    REQUIRE(0 == sender.failed_sends());
+  }
+
+  udp_in.cancel_async_recv();
+}
@@ -13,14 +13,21 @@
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/generators/catch_generators.hpp>
 
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <chrono>
 #include <future>
 #include <iostream>
+#include <mutex>
 #include <random>
+#include <span>
 #include <sstream>
+#include <stdexcept>
+#include <string>
 #include <string_view>
 #include <thread>
+#include <tuple>
 #include <vector>
 
 using namespace std::chrono_literals;
@@ -158,3 +165,256 @@ TEST_CASE("non-blocking UDP ostream operations tests", "[.][WIP]") {
     REQUIRE(data == received_data);
   }
 }
+
+TEST_CASE("UDP ostream send queue tests") {
+  using namespace nsl;
+
+  auto io              = boost::asio::io_context{};
+  const auto test_port = std::uint16_t{40300};
+
+  auto receiver = test::udp::collecting_receiver{io, test_port};
+
+  SECTION("async sends arrive, and complete, in the order that they were queued") {
+    auto remote = udp::ostream{io, "localhost", test_port, udp::send_queue_options{.completion_batch = 4}};
+
+    auto completion_mtx = std::mutex{};
+    auto completed      = std::vector<int>{};
+
+    for (auto i = 0; i < 100; ++i) {
+      remote << std::pair{std::to_string(i), [&, i](size_t) {
+                            auto _ = std::unique_lock{completion_mtx};
+                            completed.push_back(i);
+                          }};
+    }
+
+    REQUIRE_FALSE(remote.fail());
+
+    auto io_runner = test::io_runner{io};
+
+    REQUIRE(receiver.wait_for(100));
+
+    REQUIRE(test::wait_for(
+        [&]() {
+          auto _ = std::unique_lock{completion_mtx};
+          return completed.size() == 100;
+        },
+        1s));
+
+    const auto received = receiver.received();
+    for (auto i = 0; i < 100; ++i) {
+      REQUIRE(std::to_string(i) == received[i]);
+      REQUIRE(i == completed[i]);
+    }
+
+    REQUIRE(0 == remote->queued_sends());
+  }
+
+  SECTION("with the fail policy, sends beyond the high-water mark are rejected") {
+    auto remote = udp::ostream{io, "localhost", test_port, udp::send_queue_options{.high_water_mark = 4}};
+
+    // The io_context isn't running, so nothing leaves the queue.
+    for (auto i = 0; i < 4; ++i) {
+      remote << std::pair{std::to_string(i), [](size_t) {}};
+    }
+
+    REQUIRE_FALSE(remote.fail());
+    REQUIRE(4 == remote->queued_sends());
+
+    remote << std::pair{std::string{"one too many"}, [](size_t) {}};
+
+    REQUIRE(remote.fail());
+    REQUIRE(4 == remote->queued_sends());
+  }
+
+  SECTION("with the drop-oldest policy, the oldest unsent datagram is dropped") {
+    auto remote = udp::ostream{
+        io,
+        "localhost",
+        test_port,
+        udp::send_queue_options{.high_water_mark = 3, .on_overflow = udp::overflow_policy::drop_oldest}};
+
+    auto completion_mtx = std::mutex{};
+    auto aborted        = std::vector<int>{};
+    auto sent           = std::vector<int>{};
+
+    for (auto i = 0; i < 5; ++i) {
+      remote << std::pair{std::to_string(i), [&, i](const boost::system::error_code& ec, size_t) {
+                            auto _ = std::unique_lock{completion_mtx};
+                            (ec == boost::asio::error::operation_aborted ? aborted : sent).push_back(i);
+                          }};
+    }
+
+    REQUIRE_FALSE(remote.fail());
+    REQUIRE(3 == remote->queued_sends());
+
+    {
+      // The first datagram is already in flight, so it's the ones after it that get dropped.
+      auto _ = std::unique_lock{completion_mtx};
+      REQUIRE(std::vector{1, 2} == aborted);
+    }
+
+    auto io_runner = test::io_runner{io};
+
+    REQUIRE(test::wait_for(
+        [&]() {
+          auto _ = std::unique_lock{completion_mtx};
+          return sent.size() == 3;
+        },
+        3s));
+
+    REQUIRE(std::vector{0, 3, 4} == sent);
+  }
+
+  SECTION("with the block policy, the writer waits for space in the queue") {
+    auto remote = udp::ostream{
+        io, "localhost", test_port, udp::send_queue_options{.high_water_mark = 1, .on_overflow = udp::overflow_policy::block}};
+
+    remote << std::pair{std::string{"first"}, [](size_t) {}};
+
+    auto second_write = nsl::test::running_async([&]() { remote << std::pair{std::string{"second"}, [](size_t) {}}; });
+
+    REQUIRE(std::future_status::timeout == second_write.wait_for(20ms));
+
+    auto io_runner = test::io_runner{io};
+
+    REQUIRE(std::future_status::ready == second_write.wait_for(3s));
+    REQUIRE_FALSE(remote.fail());
+
+    REQUIRE(receiver.wait_for(2));
+    REQUIRE(std::vector<std::string>{"first", "second"} == receiver.received());
+  }
+
+  SECTION("a high-water mark of zero is treated as one") {
+    auto remote = udp::ostream{
+        io, "localhost", test_port, udp::send_queue_options{.high_water_mark = 0, .on_overflow = udp::overflow_policy::block}};
+
+    auto first_write = nsl::test::running_async([&]() { remote << std::pair{std::string{"first"}, [](size_t) {}}; });
+
+    REQUIRE(std::future_status::ready == first_write.wait_for(1s));
+    REQUIRE(1 == remote->queued_sends());
+  }
+
+  SECTION("the completion callback can be move-only") {
+    auto remote = udp::ostream{io, "localhost", test_port};
+
+    auto sent_promise = std::promise<size_t>{};
+    auto sent         = sent_promise.get_future();
+
+    remote << std::pair{std::string{"move-only"}, [p = std::move(sent_promise)](size_t n) mutable { p.set_value(n); }};
+    REQUIRE_FALSE(remote.fail());
+
+    auto io_runner = test::io_runner{io};
+
+    REQUIRE(std::future_status::ready == sent.wait_for(3s));
+    REQUIRE(std::string_view{"move-only"}.size() == sent.get());
+  }
+}
+
+TEST_CASE("UDP ostream prepare and commit tests") {
+  using namespace nsl;
+
+  auto io              = boost::asio::io_context{};
+  const auto test_port = std::uint16_t{40310};
+
+  auto receiver  = test::udp::collecting_receiver{io, test_port};
+  auto io_runner = test::io_runner{io};
+
+  auto remote = udp::ostream{io, "localhost", test_port};
+
+  SECTION("each commit is sent as one datagram") {
+    for (auto i = 0; i < 3; ++i) {
+      auto buf = remote.prepare(64);
+      REQUIRE(64 == buf.size());
+
+      const auto msg = fmt::format("datagram {}", i);
+      std::copy(msg.begin(), msg.end(), buf.begin());
+
+      REQUIRE(msg.size() == remote.commit(msg.size()));
+    }
+
+    REQUIRE(receiver.wait_for(3));
+    REQUIRE(std::vector<std::string>{"datagram 0", "datagram 1", "datagram 2"} == receiver.received());
+  }
+
+  SECTION("buffered stream data is sent before the committed datagram") {
+    remote << "buffered";
+
+    auto buf = remote.prepare(9);
+    std::copy_n("committed", 9, buf.begin());
+    remote.commit(9);
+
+    REQUIRE(receiver.wait_for(2));
+    REQUIRE(std::vector<std::string>{"buffered", "committed"} == receiver.received());
+  }
+
+  SECTION("committing more than was prepared throws") {
+    std::ignore = remote.prepare(8);
+    REQUIRE_THROWS_AS(remote.commit(9), std::length_error);
+  }
+}
+
+TEST_CASE("UDP ostream scatter-gather send tests") {
+  using namespace nsl;
+
+  auto io              = boost::asio::io_context{};
+  const auto test_port = std::uint16_t{40320};
+
+  auto receiver  = test::udp::collecting_receiver{io, test_port};
+  auto io_runner = test::io_runner{io};
+
+  auto remote = udp::ostream{io, "localhost", test_port};
+
+  const auto header  = std::array<std::uint8_t, 4>{'H', 'D', 'R', ':'};
+  const auto payload = std::string{"payload"};
+
+  SECTION("separate pieces are sent as one datagram") {
+    REQUIRE(header.size() + payload.size() == remote.send(header, payload));
+
+    REQUIRE(receiver.wait_for(1));
+    REQUIRE(std::vector<std::string>{"HDR:payload"} == receiver.received());
+  }
+
+  SECTION("a gathered datagram can be streamed") {
+    remote << udp::gather(header, payload, std::string_view{"!"});
+
+    REQUIRE(receiver.wait_for(1));
+    REQUIRE(std::vector<std::string>{"HDR:payload!"} == receiver.received());
+  }
+
+  SECTION("the pieces can be an array of spans") {
+    const auto pieces = std::vector<std::span<const char>>{{payload.data(), 3}, {payload.data() + 3, 4}};
+    REQUIRE(payload.size() == remote.send(pieces));
+
+    REQUIRE(receiver.wait_for(1));
+    REQUIRE(std::vector<std::string>{"payload"} == receiver.received());
+  }
+
+  SECTION("buffered stream data is sent before the gathered datagram") {
+    remote << "buffered";
+    remote.send(header, payload);
+
+    REQUIRE(receiver.wait_for(2));
+    REQUIRE(std::vector<std::string>{"buffered", "HDR:payload"} == receiver.received());
+  }
+
+  SECTION("more pieces than the socket takes in one go are still sent whole") {
+    const auto letters = std::string{"abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789abcdefghijklmnopqrstuvwxyz"};
+
+    auto pieces = std::vector<std::span<const char>>{};
+    for (auto i = std::size_t{0}; i < letters.size(); ++i) {
+      pieces.emplace_back(letters.data() + i, 1);
+    }
+
+    REQUIRE(letters.size() == remote.send(pieces));
+
+    REQUIRE(receiver.wait_for(1));
+    REQUIRE(std::vector<std::string>{letters} == receiver.received());
+  }
+
+  SECTION("a failed send sets the stream's badbit instead of throwing") {
+    const auto too_big = std::vector<char>(70000, 'x');
+
+    REQUIRE_NOTHROW(remote << udp::gather(too_big));
+    REQUIRE(remote.bad());
+  }
+}
@@ -0,0 +1,176 @@
+#include "framework.h"
+
+#include <nsl/udp/istream.hpp>
+#include <nsl/udp/ostream.hpp>
+#include <nsl/udp/probe.hpp>
+#include <nsl/udp/types.hpp>
+
+#include "test/io_runner.hpp"
+#include "test/waiting.hpp"
+
+#include <boost/asio.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <fmt/format.h>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace nsl;
+using namespace std::chrono_literals;
+
+TEST_CASE("latency histogram tests") {
+  auto histogram = udp::latency_histogram{};
+
+  SECTION("an empty histogram reports zero") {
+    REQUIRE(0 == histogram.count());
+    REQUIRE(0ns == histogram.min());
+    REQUIRE(0ns == histogram.percentile(50.0));
+  }
+
+  SECTION("percentiles are accurate to the resolution of the buckets") {
+    for (auto i = 1; i <= 1000; ++i) {
+      histogram.record(std::chrono::microseconds{i});
+    }
+
+    REQUIRE(1000 == histogram.count());
+    REQUIRE(1us == histogram.min());
+    REQUIRE(1000us == histogram.max());
+
+    for (const auto& [percent, expected] : {std::pair{50.0, 500us}, std::pair{99.0, 990us}, std::pair{100.0, 1000us}}) {
+      const auto actual = histogram.percentile(percent);
+      REQUIRE(actual >= expected);
+      REQUIRE(actual <= expected + expected / 32);
+    }
+  }
+
+  SECTION("small values are recorded exactly") {
+    for (auto i = 0; i < 32; ++i) {
+      histogram.record(std::chrono::nanoseconds{i});
+    }
+
+    REQUIRE(15ns == histogram.percentile(50.0));
+  }
+
+  SECTION("the export has one line per non-empty bucket") {
+    histogram.record(10ns);
+    histogram.record(10ns);
+    histogram.record(1ms);
+
+    auto exported = std::stringstream{};
+    histogram.export_to(exported);
+
+    auto value = std::uint64_t{0};
+    auto count = std::uint64_t{0};
+
+    REQUIRE(exported >> value >> count);
+    REQUIRE(10 == value);
+    REQUIRE(2 == count);
+
+    REQUIRE(exported >> value >> count);
+    REQUIRE(value >= 1'000'000);
+    REQUIRE(1 == count);
+
+    REQUIRE_FALSE(exported >> value >> count);
+  }
+
+  SECTION("resetting clears everything") {
+    histogram.record(5ms);
+    histogram.reset();
+
+    REQUIRE(0 == histogram.count());
+    REQUIRE(0ns == histogram.max());
+  }
+}
+
+TEST_CASE("latency probe header tests") {
+  SECTION("the header's integers are big-endian") {
+    auto stamper = udp::detail::probe_stamper{udp::probe_options{.sample_every = 2}};
+    std::ignore  = stamper.next();
+    std::ignore  = stamper.next();
+
+    // The third datagram (number 2) is sampled.
+    const auto stamp = stamper.next();
+    REQUIRE(std::array<char, 8>{0, 0, 0, 1, 0, 0, 0, 2} == std::array<char, 8>{stamp[0], stamp[1], stamp[2], stamp[3],
+                                                                              stamp[4], stamp[5], stamp[6], stamp[7]});
+
+    const auto latency = udp::detail::probe_latency(stamp.data());
+    REQUIRE(latency);
+    REQUIRE(*latency < 1s);
+  }
+
+  SECTION("a datagram stamped in the future, by a sender whose clock is ahead, is taken to have taken no time") {
+    auto stamp       = udp::detail::probe_stamper{udp::probe_options{.sample_every = 1}}.next();
+    const auto ahead = boost::endian::native_to_big(
+        udp::detail::probe_clock_now() + static_cast<std::uint64_t>(std::chrono::nanoseconds{1h}.count()));
+    std::memcpy(stamp.data() + 8, &ahead, sizeof(ahead));
+
+    REQUIRE(0ns == udp::detail::probe_latency(stamp.data()));
+  }
+}
+
+TEST_CASE("UDP latency probe tests") {
+  auto io                  = boost::asio::io_context{};
+  constexpr auto test_port = udp::port_number{40600};
+
+  auto udp_in  = udp::istream{io, test_port};
+  auto udp_out = udp::ostream{io, "localhost", test_port};
+
+  auto latencies = udp_in.enable_latency_probe();
+
+  SECTION("sampled datagrams are measured and the probe header is hidden from the reader") {
+    udp_out.enable_latency_probe(udp::probe_options{.sample_every = 4});
+
+    auto mtx      = std::mutex{};
+    auto received = std::vector<std::string>{};
+    udp_in >> [&](auto&& is, size_t n) {
+      auto str = std::string(n, '\0');
+      is.read(str.data(), n);
+
+      auto _ = std::unique_lock{mtx};
+      received.push_back(std::move(str));
+    };
+
+    auto _ = test::io_runner{io};
+
+    auto sent = std::vector<std::string>{};
+    for (auto i = 0; i < 20; ++i) {
+      sent.push_back(fmt::format("datagram {}", i));
+      udp_out << sent.back() << udp::flush;
+    }
+
+    REQUIRE(test::wait_for(
+        [&]() {
+          auto _ = std::unique_lock{mtx};
+          return received.size() == sent.size();
+        },
+        3s));
+
+    REQUIRE(sent == received);
+    REQUIRE(5 == latencies->count());
+    REQUIRE(latencies->max() < 1s);
+
+    udp_in.cancel_async_recv();
+  }
+
+  SECTION("blocking reads and async writes are probed too") {
+    udp_out.enable_latency_probe(udp::probe_options{.sample_every = 1});
+
+    auto _ = test::io_runner{io};
+
+    auto sent_bytes = std::vector<std::byte>(256, std::byte{0x5A});
+    udp_out << std::pair{sent_bytes, [](size_t) {}};
+
+    auto recv_bytes = std::vector<std::byte>(sent_bytes.size());
+    udp_in >> recv_bytes;
+
+    REQUIRE(sent_bytes == recv_bytes);
+    REQUIRE(1 == latencies->count());
+  }
+}
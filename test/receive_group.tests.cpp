@@ -0,0 +1,150 @@
+#include "framework.h"
+
+#include <nsl/udp/ostream.hpp>
+#include <nsl/udp/receive_group.hpp>
+#include <nsl/udp/types.hpp>
+
+#include "test/waiting.hpp"
+
+#include <boost/asio.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace nsl;
+using namespace std::chrono_literals;
+
+TEST_CASE("UDP receive group tests") {
+  constexpr auto first_port = udp::port_number{40900};
+  constexpr auto port_count = udp::port_number{32};
+
+  auto io = boost::asio::io_context{};
+
+  auto mtx      = std::mutex{};
+  auto received = std::map<udp::port_number, std::vector<std::string>>{};
+  auto threads  = std::set<std::thread::id>{};
+
+  auto on_datagram = [&](udp::port_number port) {
+    return [&, port](auto&& is, size_t n) {
+      auto str = std::string(n, '\0');
+      is.read(str.data(), n);
+
+      auto _ = std::unique_lock{mtx};
+      received[port].push_back(std::move(str));
+      threads.insert(std::this_thread::get_id());
+    };
+  };
+
+  auto received_count = [&]() {
+    auto _     = std::unique_lock{mtx};
+    auto count = std::size_t{0};
+    for (const auto& [port, datagrams] : received) {
+      count += datagrams.size();
+    }
+
+    return count;
+  };
+
+  SECTION("every port's datagrams are handed to its own callback, on the group's threads") {
+    auto group = udp::receive_group{{.thread_count = 2}};
+    for (auto port = first_port; port < first_port + port_count; ++port) {
+      REQUIRE(port == group.add(port, on_datagram(port)));
+    }
+
+    REQUIRE(port_count == group.size());
+    REQUIRE(2 == group.thread_count());
+
+    auto udp_out = std::vector<std::unique_ptr<udp::ostream>>{};
+    for (auto port = first_port; port < first_port + port_count; ++port) {
+      udp_out.push_back(std::make_unique<udp::ostream>(io, "localhost", port));
+      *udp_out.back() << "to " << port << udp::flush;
+    }
+
+    REQUIRE(test::wait_for([&]() { return received_count() == port_count; }, 2s));
+
+    auto _ = std::unique_lock{mtx};
+    for (auto port = first_port; port < first_port + port_count; ++port) {
+      REQUIRE(std::vector<std::string>{"to " + std::to_string(port)} == received[port]);
+    }
+
+    REQUIRE_FALSE(threads.contains(std::this_thread::get_id()));
+  }
+
+  SECTION("everything that's waiting on a port is delivered, in order, even with a small batch limit") {
+    auto group = udp::receive_group{{.batch_limit = 4}};
+    group.add(first_port, on_datagram(first_port));
+
+    auto udp_out = udp::ostream{io, "localhost", first_port};
+    auto sent    = std::vector<std::string>{};
+    for (auto i = 0; i < 50; ++i) {
+      sent.push_back("datagram " + std::to_string(i));
+      udp_out << sent.back() << udp::flush;
+    }
+
+    REQUIRE(test::wait_for([&]() { return received_count() == sent.size(); }, 2s));
+
+    auto _ = std::unique_lock{mtx};
+    REQUIRE(sent == received[first_port]);
+  }
+
+  SECTION("any_port binds a free port") {
+    auto group      = udp::receive_group{};
+    const auto port = group.add(udp::any_port, on_datagram(udp::any_port));
+
+    REQUIRE(udp::any_port != port);
+
+    auto udp_out = udp::ostream{io, "localhost", port};
+    udp_out << "hello" << udp::flush;
+
+    REQUIRE(test::wait_for([&]() { return received_count() == 1; }, 2s));
+  }
+
+  SECTION("a removed port is closed, and the others carry on") {
+    auto group = udp::receive_group{};
+    group.add(first_port, on_datagram(first_port));
+    group.add(first_port + 1, on_datagram(first_port + 1));
+
+    REQUIRE(group.remove(first_port));
+    REQUIRE_FALSE(group.remove(first_port));
+    REQUIRE(1 == group.size());
+
+    // The port can be bound again, now that the group has let go of it.
+    REQUIRE(first_port == group.add(first_port, on_datagram(first_port)));
+    REQUIRE(group.remove(first_port));
+
+    auto udp_out = udp::ostream{io, "localhost", first_port + 1};
+    udp_out << "still here" << udp::flush;
+
+    REQUIRE(test::wait_for([&]() { return received_count() == 1; }, 2s));
+
+    auto _ = std::unique_lock{mtx};
+    REQUIRE(std::vector<std::string>{"still here"} == received[first_port + 1]);
+  }
+
+  SECTION("a port can be removed while, or after, the group is stopped") {
+    for (auto attempt = 0; attempt < 20; ++attempt) {
+      auto group = udp::receive_group{{.thread_count = 2}};
+      group.add(first_port, on_datagram(first_port));
+      group.add(first_port + 1, on_datagram(first_port + 1));
+
+      auto stopper = std::thread{[&group]() { group.stop(); }};
+      REQUIRE(group.remove(first_port));
+      stopper.join();
+
+      REQUIRE(group.remove(first_port + 1));
+      REQUIRE(0 == group.size());
+    }
+
+    // Both ports were closed, even though the group wasn't running to close them.
+    auto group = udp::receive_group{};
+    REQUIRE(first_port == group.add(first_port, on_datagram(first_port)));
+    REQUIRE(first_port + 1 == group.add(first_port + 1, on_datagram(first_port + 1)));
+  }
+}
@@ -0,0 +1,107 @@
+#include "framework.h"
+
+#include <nsl/udp/istream.hpp>
+#include <nsl/udp/receive_ring.hpp>
+#include <nsl/udp/types.hpp>
+
+#include "test/waiting.hpp"
+
+#include <boost/asio.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <array>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace nsl;
+using namespace std::chrono_literals;
+
+TEST_CASE("UDP istream receive ring tests") {
+  auto io                  = boost::asio::io_context{};
+  constexpr auto test_port = udp::port_number{41000};
+
+  auto udp_in = udp::istream{io, test_port};
+
+  auto mtx      = std::mutex{};
+  auto received = std::vector<std::string>{};
+
+  auto handle_datagram = [&](auto&& is, size_t n) {
+    auto str = std::string(n, '\0');
+    is.read(str.data(), n);
+
+    auto _ = std::unique_lock{mtx};
+    received.push_back(std::move(str));
+  };
+
+  auto received_count = [&]() {
+    auto _ = std::unique_lock{mtx};
+    return received.size();
+  };
+
+  // Several threads run the io_context, so that the ring's receives can complete on different threads.
+  auto work    = boost::asio::make_work_guard(io);
+  auto threads = std::vector<std::thread>{};
+  for (auto i = 0; i < 4; ++i) {
+    threads.emplace_back([&io]() { io.run(); });
+  }
+
+  auto sender   = boost::asio::ip::udp::socket{io, boost::asio::ip::udp::endpoint{boost::asio::ip::udp::v4(), 0}};
+  auto resolver = boost::asio::ip::udp::resolver{io};
+  auto endpoint = resolver.resolve(boost::asio::ip::udp::v4(), "localhost", std::to_string(test_port)).begin()->endpoint();
+
+  SECTION("datagrams are delivered in the order that they were sent") {
+    udp_in >> udp::receive_ring(handle_datagram, {.depth = 16});
+    REQUIRE_FALSE(udp_in.fail());
+
+    auto sent = std::vector<std::string>{};
+    for (auto i = 0; i < 200; ++i) {
+      sent.push_back("datagram " + std::to_string(i));
+      sender.send_to(boost::asio::buffer(sent.back()), endpoint);
+    }
+
+    REQUIRE(test::wait_for([&]() { return received_count() == sent.size(); }, 5s));
+
+    auto _ = std::unique_lock{mtx};
+    REQUIRE(sent == received);
+  }
+
+  SECTION("datagrams bigger than 4 KiB aren't truncated") {
+    udp_in >> udp::receive_ring(handle_datagram);
+
+    const auto big = std::string(9000, 'x');
+    sender.send_to(boost::asio::buffer(big), endpoint);
+
+    REQUIRE(test::wait_for([&]() { return received_count() == 1; }, 2s));
+
+    auto _ = std::unique_lock{mtx};
+    REQUIRE(big == received.front());
+  }
+
+  SECTION("cancelling the ring stops all of its receives, and then a synchronous read works") {
+    udp_in >> udp::receive_ring(handle_datagram, {.depth = 4});
+
+    sender.send_to(boost::asio::buffer(std::string{"async"}), endpoint);
+    REQUIRE(test::wait_for([&]() { return received_count() == 1; }, 2s));
+
+    udp_in.cancel_async_recv();
+
+    sender.send_to(boost::asio::buffer(std::string{"sync"}), endpoint);
+
+    auto buf    = std::array<char, 16>{};
+    auto result = udp_in.read_for(buf, 2s);
+    REQUIRE(result);
+    REQUIRE("sync" == std::string(buf.data(), result.size));
+    REQUIRE(1 == received_count());
+  }
+
+  udp_in.cancel_async_recv();
+
+  work.reset();
+  io.stop();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
@@ -0,0 +1,156 @@
+#include "framework.h"
+
+#include <nsl/runtime.hpp>
+#include <nsl/udp/types.hpp>
+
+#include "test/waiting.hpp"
+
+#include <boost/asio.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <limits>
+#include <set>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace nsl;
+using namespace std::chrono_literals;
+
+namespace {
+
+#if defined(_WIN32) or defined(__linux__)
+// Whether the calling thread is allowed to run on CPU 0, and nowhere else.
+[[nodiscard]] bool pinned_to_cpu_0() {
+#if defined(_WIN32)
+  // There's no GetThreadAffinityMask(), but setting the mask hands back the old one, which is then put back.
+  const auto previous = ::SetThreadAffinityMask(::GetCurrentThread(), DWORD_PTR{1});
+  ::SetThreadAffinityMask(::GetCurrentThread(), previous);
+  return previous == DWORD_PTR{1};
+#else
+  auto cpus = cpu_set_t{};
+  CPU_ZERO(&cpus);
+  if (0 != ::pthread_getaffinity_np(::pthread_self(), sizeof(cpus), &cpus)) {
+    return false;
+  }
+
+  return 1 == CPU_COUNT(&cpus) and CPU_ISSET(0, &cpus);
+#endif
+}
+#endif
+
+}  // namespace
+
+TEST_CASE("runtime tests") {
+  SECTION("a default runtime has a single context") {
+    auto rt = runtime{};
+    REQUIRE(1 == rt.size());
+  }
+
+  SECTION("asking for zero threads still gives one context") {
+    auto rt = runtime{0};
+    REQUIRE(1 == rt.size());
+  }
+
+  SECTION("contexts are handed out round-robin") {
+    auto rt = runtime{3};
+    REQUIRE(3 == rt.size());
+
+    auto contexts = std::set<boost::asio::io_context*>{};
+    for (auto i = 0; i < 3; ++i) {
+      contexts.insert(&rt.next_context());
+    }
+
+    REQUIRE(3 == contexts.size());
+    REQUIRE(&rt.context(0) == &rt.next_context());
+  }
+
+  SECTION("work posted to each context runs on a different thread") {
+    auto rt = runtime{2};
+
+    auto thread_ids = std::set<std::thread::id>{};
+    auto mtx        = std::mutex{};
+    auto done       = std::atomic_int{0};
+
+    for (auto i = std::size_t{0}; i < rt.size(); ++i) {
+      boost::asio::post(rt.context(i), [&]() {
+        {
+          auto _ = std::unique_lock{mtx};
+          thread_ids.insert(std::this_thread::get_id());
+        }
+        ++done;
+      });
+    }
+
+    REQUIRE(test::wait_for([&]() { return done.load() == 2; }, 1s));
+    REQUIRE(2 == thread_ids.size());
+    REQUIRE(0 == thread_ids.count(std::this_thread::get_id()));
+  }
+
+#if defined(_WIN32) or defined(__linux__)
+  SECTION("threads can be pinned to a CPU") {
+    auto rt = runtime{2, {0}};
+    REQUIRE(2 == rt.size());
+
+    // Each context's thread checks its own affinity.
+    auto pinned = std::vector<std::future<bool>>{};
+    for (auto i = std::size_t{0}; i < rt.size(); ++i) {
+      auto check = std::packaged_task<bool()>{pinned_to_cpu_0};
+      pinned.push_back(check.get_future());
+      boost::asio::post(rt.context(i), std::move(check));
+    }
+
+    for (auto& p : pinned) {
+      REQUIRE(std::future_status::ready == p.wait_for(1s));
+      REQUIRE(p.get());
+    }
+  }
+
+  SECTION("pinning a thread to a CPU that's out of range throws") {
+    REQUIRE_THROWS_AS(runtime(1, {std::numeric_limits<cpu_id>::max()}), std::system_error);
+  }
+#endif
+
+  SECTION("streams made by the runtime exchange data without a separate io runner") {
+    constexpr auto test_port = udp::port_number{40100};
+
+    auto rt = runtime{2};
+
+    auto recv_data = std::string{};
+    auto received  = std::atomic_bool{false};
+
+    auto udp_in = rt.make_istream(test_port);
+    udp_in >> [&](auto&& is, size_t n) {
+      if (received.load()) {
+        return;
+      }
+
+      recv_data.resize(n);
+      is.read(recv_data.data(), n);
+      received = true;
+    };
+
+    auto udp_out = rt.make_ostream("localhost", test_port);
+    udp_out << "hello, runtime!" << udp::flush;
+
+    REQUIRE(test::wait_for([&]() { return received.load(); }, 1s));
+    REQUIRE("hello, runtime!" == recv_data);
+
+    rt.stop();
+  }
+
+  SECTION("stopping more than once is harmless") {
+    auto rt = runtime{2};
+    rt.stop();
+    rt.stop();
+  }
+}
@@ -0,0 +1,206 @@
+#include "framework.h"
+
+#include <nsl/udp/istream.hpp>
+#include <nsl/udp/ostream.hpp>
+#include <nsl/udp/sequenced.hpp>
+#include <nsl/udp/types.hpp>
+
+#include "test/impairment_proxy.hpp"
+#include "test/io_runner.hpp"
+#include "test/waiting.hpp"
+
+#include <boost/asio.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace nsl;
+using namespace std::chrono_literals;
+
+namespace {
+
+// Feeds a datagram, as a sequencing ostream would have sent it (with its sequence number big-endian), straight into a
+// receive callback.
+template <typename Receiver_T>
+void feed(Receiver_T& receiver, std::uint64_t sequence, const std::string& data) {
+  auto datagram = std::string(sizeof(sequence), '\0');
+  for (auto i = sizeof(sequence); i-- > 0; sequence >>= 8) {
+    datagram[i] = static_cast<char>(sequence & 0xFF);
+  }
+  datagram += data;
+
+  auto is = std::istringstream{datagram};
+  receiver(is, datagram.size());
+}
+
+}  // namespace
+
+TEST_CASE("sequenced feed tests") {
+  auto delivered = std::vector<std::string>{};
+  auto gaps      = std::vector<std::pair<std::uint64_t, std::uint64_t>>{};
+
+  auto receiver = udp::sequenced(
+      [&](auto&& is, size_t n) {
+        auto str = std::string(n, '\0');
+        is.read(str.data(), n);
+        delivered.push_back(std::move(str));
+      },
+      udp::sequenced_options{.window = 4, .max_datagram_size = 16},
+      [&](std::uint64_t first, std::uint64_t count) { gaps.emplace_back(first, count); });
+
+  SECTION("datagrams that arrive in order are delivered straight away") {
+    feed(receiver, 10, "a");
+    feed(receiver, 11, "b");
+    feed(receiver, 12, "c");
+
+    REQUIRE(std::vector<std::string>{"a", "b", "c"} == delivered);
+    REQUIRE(3 == receiver.stats().delivered);
+    REQUIRE(0 == receiver.stats().reordered);
+  }
+
+  SECTION("datagrams that arrive early are held until the ones before them arrive") {
+    feed(receiver, 0, "a");
+    feed(receiver, 2, "c");
+    feed(receiver, 3, "d");
+
+    REQUIRE(std::vector<std::string>{"a"} == delivered);
+
+    feed(receiver, 1, "b");
+
+    REQUIRE(std::vector<std::string>{"a", "b", "c", "d"} == delivered);
+    REQUIRE(2 == receiver.stats().reordered);
+    REQUIRE(gaps.empty());
+  }
+
+  SECTION("duplicates are dropped") {
+    feed(receiver, 0, "a");
+    feed(receiver, 0, "a");
+    feed(receiver, 2, "c");
+    feed(receiver, 2, "c");
+
+    REQUIRE(std::vector<std::string>{"a"} == delivered);
+    REQUIRE(2 == receiver.stats().duplicates);
+  }
+
+  SECTION("a gap is given up on when the window fills up behind it") {
+    feed(receiver, 0, "a");
+    feed(receiver, 2, "c");
+    feed(receiver, 3, "d");
+    feed(receiver, 4, "e");
+
+    REQUIRE(std::vector<std::string>{"a"} == delivered);
+
+    feed(receiver, 5, "f");
+
+    REQUIRE(std::vector<std::string>{"a", "c", "d", "e", "f"} == delivered);
+    REQUIRE(std::vector<std::pair<std::uint64_t, std::uint64_t>>{{1, 1}} == gaps);
+    REQUIRE(1 == receiver.stats().lost);
+
+    SECTION("and if it turns up afterwards, it's late") {
+      feed(receiver, 1, "b");
+
+      REQUIRE(5 == delivered.size());
+      REQUIRE(1 == receiver.stats().late);
+      REQUIRE(0 == receiver.stats().duplicates);
+    }
+  }
+
+  SECTION("an early datagram that's too big to hold is counted as oversized, not lost") {
+    feed(receiver, 0, "a");
+    feed(receiver, 2, "this is far too big to hold");
+    feed(receiver, 3, "d");
+    feed(receiver, 1, "b");
+
+    REQUIRE(std::vector<std::string>{"a", "b", "d"} == delivered);
+    REQUIRE(gaps.empty());
+    REQUIRE(1 == receiver.stats().oversized);
+    REQUIRE(0 == receiver.stats().lost);
+  }
+
+  SECTION("gaps can be skipped without waiting for the window to fill") {
+    feed(receiver, 0, "a");
+    feed(receiver, 2, "c");
+    feed(receiver, 4, "e");
+
+    receiver.skip_gaps();
+
+    REQUIRE(std::vector<std::string>{"a", "c", "e"} == delivered);
+    REQUIRE(std::vector<std::pair<std::uint64_t, std::uint64_t>>{{1, 1}, {3, 1}} == gaps);
+    REQUIRE(2 == receiver.stats().lost);
+
+    feed(receiver, 5, "f");
+
+    REQUIRE(std::vector<std::string>{"a", "c", "e", "f"} == delivered);
+  }
+
+  SECTION("a jump in the sequence is reported as one gap") {
+    feed(receiver, 0, "a");
+    feed(receiver, 1000, "b");
+
+    REQUIRE(std::vector<std::string>{"a", "b"} == delivered);
+    REQUIRE(std::vector<std::pair<std::uint64_t, std::uint64_t>>{{1, 999}} == gaps);
+  }
+}
+
+TEST_CASE("sequenced UDP feed tests") {
+  constexpr auto proxy_port = udp::port_number{40700};
+  constexpr auto recv_port  = udp::port_number{40701};
+
+  auto io = boost::asio::io_context{};
+
+  auto mtx      = std::mutex{};
+  auto received = std::vector<int>{};
+
+  auto receiver = udp::sequenced([&](auto&& is, size_t n) {
+    auto str = std::string(n, '\0');
+    is.read(str.data(), n);
+
+    auto _ = std::unique_lock{mtx};
+    received.push_back(std::stoi(str));
+  });
+
+  auto udp_in = udp::istream{io, recv_port};
+  udp_in >> receiver;
+
+  auto imp = test::udp::impairments{.duplicate_rate = 0.2, .reorder_rate = 0.2, .seed = 1234};
+
+  auto proxy = test::udp::impairment_proxy{io, proxy_port, "localhost", recv_port, imp};
+  auto _     = test::io_runner{io};
+
+  auto udp_out = udp::ostream{io, "localhost", proxy_port};
+  udp_out.enable_sequencing();
+
+  constexpr auto count = 200;
+  for (auto i = 0; i < count; ++i) {
+    udp_out << std::to_string(i) << udp::flush;
+  }
+
+  REQUIRE(test::wait_for(
+      [&]() {
+        auto _ = std::unique_lock{mtx};
+        return received.size() >= count;
+      },
+      3s));
+
+  udp_in.cancel_async_recv();
+
+  auto expected = std::vector<int>(count);
+  for (auto i = 0; i < count; ++i) {
+    expected[i] = i;
+  }
+
+  auto lock = std::unique_lock{mtx};
+  received.resize(count);
+  REQUIRE(expected == received);
+
+  const auto stats = receiver.stats();
+  REQUIRE(0 == stats.lost);
+  REQUIRE(stats.duplicates > 0);
+  REQUIRE(stats.reordered > 0);
+}
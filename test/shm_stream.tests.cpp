@@ -0,0 +1,297 @@
+#include "framework.h"
+
+#include <nsl/shm/stream.hpp>
+
+#include "test/io_runner.hpp"
+#include "test/waiting.hpp"
+
+#include <boost/asio.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using nlohmann::json;
+using namespace nsl;
+using namespace std::chrono_literals;
+
+TEST_CASE("reading and writing to shared memory streams") {
+  auto io = boost::asio::io_context{};
+
+  const auto channel = std::string{"nsl_shm_stream_tests"};
+
+  SECTION("blocking streams") {
+    auto shm_in  = shm::istream{io, channel};
+    auto shm_out = shm::ostream{io, channel};
+
+    SECTION("writing and reading JSON") {
+      auto sent_json = json::parse(R"({"bool_field": true, "int_field": 12345, "string_field": "ahoy there!"})");
+
+      auto recv_data = test::running_async([&]() {
+        auto recv_json = json{};
+        shm_in >> recv_json;
+        return recv_json;
+      });
+
+      shm_out << sent_json << std::endl;
+
+      REQUIRE(sent_json == recv_data.get());
+    }
+
+    SECTION("writing and reading bytes") {
+      auto sent_bytes = std::vector<std::byte>(1024);
+      for (auto i = 0u; i < sent_bytes.size(); ++i) {
+        sent_bytes[i] = static_cast<std::byte>(i & 0xFF);
+      }
+
+      shm_out << sent_bytes << shm::flush;
+
+      auto recv_bytes = std::vector<std::byte>(sent_bytes.size());
+      shm_in >> recv_bytes;
+
+      REQUIRE(sent_bytes == recv_bytes);
+    }
+
+    SECTION("a blocked read can be cancelled") {
+      auto recv_value = test::running_async([&]() {
+        auto recv_str = std::string{};
+        shm_in >> recv_str;
+        return shm_in.fail();
+      });
+
+      std::this_thread::sleep_for(10ms);
+      shm_in.cancel_sync_recv();
+
+      REQUIRE(std::future_status::ready == recv_value.wait_for(1s));
+      REQUIRE(recv_value.get());
+    }
+
+    SECTION("building a datagram in place in the ring") {
+      constexpr auto message = std::string_view{"built in place"};
+
+      auto buf = shm_out.prepare(64);
+      REQUIRE(64 == buf.size());
+      std::copy(message.begin(), message.end(), buf.begin());
+      REQUIRE(message.size() == shm_out.commit(message.size()));
+
+      auto recv_bytes = std::vector<char>(message.size());
+      shm_in >> recv_bytes;
+
+      REQUIRE(message == std::string_view{recv_bytes.data(), recv_bytes.size()});
+    }
+  }
+
+  SECTION("a write that's waiting for a reader that's stopped can be cancelled") {
+    // The reader never reads, so the small ring fills up and the writer is left waiting for space.
+    auto shm_in  = shm::istream{io, channel, 256};
+    auto shm_out = shm::ostream{io, channel, 256};
+
+    // This stops at the first write that leaves the stream anything but good, which should be the one that was cancelled.
+    auto state_after_cancel = test::running_async([&]() {
+      const auto datagram = std::string(64, 'x');
+      for (auto i = 0; i < 100 and shm_out.good(); ++i) {
+        shm_out << datagram << shm::flush;
+      }
+
+      return shm_out.rdstate();
+    });
+
+    REQUIRE(std::future_status::timeout == state_after_cancel.wait_for(50ms));
+    shm_out.cancel_send();
+
+    REQUIRE(std::future_status::ready == state_after_cancel.wait_for(1s));
+    REQUIRE(std::ios_base::badbit == (state_after_cancel.get() & std::ios_base::badbit));
+  }
+
+  SECTION("opening a ring that its creator never finished setting up gives up") {
+    namespace bip = boost::interprocess;
+
+    // This is what a creator that died before initialising the ring leaves behind: a zero-filled segment.
+    {
+      auto shm = bip::shared_memory_object{bip::create_only, channel.c_str(), bip::read_write};
+      shm.truncate(4096);
+    }
+
+    const auto started = std::chrono::steady_clock::now();
+    REQUIRE_THROWS_AS(shm::ostream(io, channel), std::runtime_error);
+    REQUIRE(std::chrono::steady_clock::now() - started < 5s);
+
+    bip::shared_memory_object::remove(channel.c_str());
+  }
+
+  SECTION("an async write to a full ring fails, rather than waiting for the reader") {
+    auto shm_in  = shm::istream{io, channel, 256};
+    auto shm_out = shm::ostream{io, channel, 256};
+
+    auto writes = test::running_async([&]() {
+      auto accepted = 0;
+      for (; accepted < 100; ++accepted) {
+        if (not(shm_out << std::pair{std::string(64, 'x'), [](size_t) {}})) {
+          break;
+        }
+      }
+
+      return accepted;
+    });
+
+    REQUIRE(std::future_status::ready == writes.wait_for(1s));
+
+    // Each 64-byte datagram takes 72 bytes of the ring, with its length, so three of them fit in it.
+    REQUIRE(3 == writes.get());
+  }
+
+  SECTION("non-blocking streams") {
+    auto mtx      = std::mutex{};
+    auto received = std::vector<std::string>{};
+
+    auto shm_in = shm::istream{io, channel, 256};
+    shm_in >> [&](auto&& is, size_t n) {
+      auto str = std::string(n, '\0');
+      is.read(str.data(), n);
+
+      auto _ = std::unique_lock{mtx};
+      received.push_back(std::move(str));
+    };
+
+    auto _ = test::io_runner{io};
+
+    SECTION("many datagrams go through a small ring in order") {
+      // The ring only holds a few datagrams, so the writer has to wait for the reader and the ring wraps many times.
+      auto shm_out = shm::ostream{io, channel, 256};
+
+      auto sent = std::vector<std::string>{};
+      for (auto i = 0; i < 500; ++i) {
+        sent.push_back(fmt::format("datagram number {}", i));
+        shm_out << sent.back() << shm::flush;
+      }
+
+      REQUIRE(test::wait_for(
+          [&]() {
+            auto _ = std::unique_lock{mtx};
+            return received.size() == sent.size();
+          },
+          3s));
+
+      REQUIRE(sent == received);
+    }
+
+    SECTION("async writes run their callbacks") {
+      auto shm_out = shm::ostream{io, channel, 256};
+
+      auto sent_bytes = std::atomic_size_t{0};
+      shm_out << std::pair{std::string{"hello, shared memory!"}, [&](size_t n) { sent_bytes += n; }};
+
+      REQUIRE(test::wait_for([&]() { return sent_bytes.load() == 21; }, 1s));
+      REQUIRE(test::wait_for(
+          [&]() {
+            auto _ = std::unique_lock{mtx};
+            return received.size() == 1;
+          },
+          1s));
+      REQUIRE("hello, shared memory!" == received.front());
+    }
+
+    shm_in.cancel_async_recv();
+  }
+
+  SECTION("a read that's restarted while several threads run the io_context gets each datagram once, in order") {
+    auto mtx      = std::mutex{};
+    auto received = std::vector<int>{};
+    auto on_data  = [&](auto&& is, size_t n) {
+      auto str = std::string(n, '\0');
+      is.read(str.data(), n);
+
+      auto _ = std::unique_lock{mtx};
+      received.push_back(std::stoi(str));
+    };
+
+    auto shm_in  = shm::istream{io, channel, 1024};
+    auto shm_out = shm::ostream{io, channel, 1024};
+    shm_in >> on_data;
+
+    // Cancelling the read lets go of its hold on the io_context, so something else has to keep the threads running.
+    auto work    = boost::asio::make_work_guard(io);
+    auto runners = std::vector<std::unique_ptr<test::io_runner>>{};
+    for (auto i = 0; i < 4; ++i) {
+      runners.push_back(std::make_unique<test::io_runner>(io));
+    }
+
+    constexpr auto datagram_count = 5000;
+    auto writes                   = test::running_async([&]() {
+      for (auto i = 0; i < datagram_count; ++i) {
+        shm_out << std::to_string(i) << shm::flush;
+      }
+    });
+
+    for (auto i = 0; i < 100; ++i) {
+      std::this_thread::sleep_for(100us);
+      shm_in.cancel_async_recv();
+      shm_in >> on_data;
+    }
+
+    writes.get();
+    REQUIRE(test::wait_for(
+        [&]() {
+          auto _ = std::unique_lock{mtx};
+          return received.size() >= datagram_count;
+        },
+        3s));
+
+    shm_in.cancel_async_recv();
+
+    auto expected = std::vector<int>(datagram_count);
+    std::iota(expected.begin(), expected.end(), 0);
+    REQUIRE(expected == received);
+  }
+
+  SECTION("IO stream") {
+    auto request  = json::parse(R"({"bool_field": true, "int_field": 12345, "string_field": "ahoy there!"})");
+    auto response = json{};
+
+    auto client     = shm::stream{io, "nsl_shm_client", "nsl_shm_server"};
+    auto server_in  = shm::istream{io, "nsl_shm_server"};
+    auto server_out = shm::ostream{io, "nsl_shm_client"};
+
+    auto mtx        = std::mutex{};
+    auto lock       = std::unique_lock{mtx};
+    auto data_ready = std::condition_variable{};
+
+    client >> [&](auto&& is, size_t n) {
+      auto str = std::string(n, '\0');
+      is.read(str.data(), n);
+      {
+        auto _   = std::unique_lock{mtx};
+        response = json::parse(str);
+      }
+      data_ready.notify_all();
+    };
+
+    auto _ = test::io_runner{io};
+
+    auto served = test::running_async([&]() {
+      auto req = json{};
+      server_in >> req;
+      server_out << (req == request ? json{{"result", 200}} : json{{"result", 400}}) << shm::flush;
+    });
+
+    client << request << std::endl;
+
+    REQUIRE(data_ready.wait_for(lock, 3s, [&]() { return not response.is_null(); }));
+    REQUIRE(json{{"result", 200}} == response);
+
+    served.get();
+    client.cancel_async_recv();
+  }
+}
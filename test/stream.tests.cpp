@@ -13,10 +13,13 @@
 #include <wite/collections/make_vector.hpp>
 
 #include <algorithm>
+#include <array>
 #include <chrono>
 #include <condition_variable>
+#include <memory>
 #include <mutex>
 #include <random>
+#include <string_view>
 #include <thread>
 #include <vector>
 
@@ -143,5 +146,60 @@ TEST_CASE("reading and writing to UDP streams") {
 
       REQUIRE(json{{"result", 200}} == response);
     }
+
+    SECTION("sends and receives on the same socket") {
+      auto peer = boost::asio::ip::udp::socket{io, boost::asio::ip::udp::endpoint{boost::asio::ip::udp::v4(), test_port + 2}};
+
+      auto lock       = std::unique_lock{mtx};
+      auto data_ready = std::condition_variable{};
+      auto reply      = std::string{};
+
+      auto remote = udp::stream{io, test_port, "localhost", test_port + 2};
+      remote >> [&](auto&& is, size_t n) {
+        auto str = std::string(n, '\0');
+        is.read(str.data(), n);
+        {
+          auto _ = std::unique_lock{mtx};
+          reply  = std::move(str);
+        }
+        data_ready.notify_all();
+      };
+
+      auto _ = test::io_runner{io};
+
+      remote << std::string_view{"ping"} << udp::flush;
+
+      auto buf    = std::array<char, 16>{};
+      auto sender = boost::asio::ip::udp::endpoint{};
+      REQUIRE(4 == peer.receive_from(boost::asio::buffer(buf), sender));
+      REQUIRE(test_port == sender.port());
+
+      // Reply to wherever the ping came from, as a peer that knows nothing about the stream would.
+      peer.send_to(boost::asio::buffer(std::string_view{"pong"}), sender);
+
+      REQUIRE(data_ready.wait_for(lock, 3s, [&]() { return not reply.empty(); }));
+      REQUIRE("pong" == reply);
+
+      remote.cancel_async_recv();
+    }
+  }
+
+  SECTION("an ostream that shares a socket keeps sending after the istream that shared it has gone") {
+    auto peer   = boost::asio::ip::udp::socket{io, boost::asio::ip::udp::endpoint{boost::asio::ip::udp::v4(), test_port + 3}};
+    auto socket = std::make_shared<boost::asio::ip::udp::socket>(
+        io, boost::asio::ip::udp::endpoint{boost::asio::ip::udp::v4(), test_port + 4});
+
+    auto udp_out = udp::ostream{io, socket, "localhost", test_port + 3};
+    {
+      auto udp_in = udp::istream{io, socket};
+    }
+
+    udp_out << std::string_view{"still here"} << udp::flush;
+    REQUIRE(udp_out.good());
+
+    auto buf    = std::array<char, 16>{};
+    auto sender = boost::asio::ip::udp::endpoint{};
+    REQUIRE(10 == peer.receive_from(boost::asio::buffer(buf), sender));
+    REQUIRE(test_port + 4 == sender.port());
   }
-}
\ No newline at end of file
+}
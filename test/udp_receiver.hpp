@@ -2,18 +2,23 @@
 
 #include <nsl/udp/types.hpp>
 
+#include "test/waiting.hpp"
+
 #include <boost/asio.hpp>
 
+#include <chrono>
 #include <cstdint>
 #include <format>
 #include <functional>
 #include <istream>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <ostream>
 #include <span>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 namespace nsl::test::udp {
 
@@ -73,4 +78,37 @@ class receiver {
   static constexpr auto _recv_buf_size = 8192;
   boost::asio::streambuf _recv_data;
 };
+
+// A receiver that keeps every datagram it gets, as a string, in the order that they arrived.
+class collecting_receiver {
+ public:
+  explicit collecting_receiver(boost::asio::io_context& io, ::nsl::udp::port_number port)
+      : _receiver{io, port, [this](std::istream& is, size_t n) {
+                    auto str = std::string(n, '\0');
+                    is.read(str.data(), static_cast<std::streamsize>(n));
+
+                    auto _ = std::unique_lock{_mtx};
+                    _received.push_back(std::move(str));
+                  }} {}
+
+  [[nodiscard]] std::vector<std::string> received() const {
+    auto _ = std::unique_lock{_mtx};
+    return _received;
+  }
+
+  // Waits for count datagrams to have arrived.
+  [[nodiscard]] bool wait_for(std::size_t count, std::chrono::milliseconds timeout = std::chrono::seconds{3}) const {
+    return ::nsl::test::wait_for(
+        [&]() {
+          auto _ = std::unique_lock{_mtx};
+          return _received.size() == count;
+        },
+        timeout);
+  }
+
+ private:
+  mutable std::mutex _mtx;
+  std::vector<std::string> _received;
+  receiver _receiver;  // Last, so that it stops receiving before the rest is destroyed.
+};
 }  // namespace nsl::test::udp